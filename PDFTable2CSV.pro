@@ -1,9 +1,9 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++11 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
-LIBS += -L/usr/local/lib/
+LIBS += -L/usr/local/lib/ -lz
 QT_CONFIG -= no-pkg-config
 
 CONFIG  += link_pkgconfig
@@ -13,15 +13,52 @@ PKGCONFIG += opencv
 SOURCES += main.cpp \
     segmentation.cpp \
     imagefromfile.cpp \
+    imagefrommemory.cpp \
     ocr.cpp \
-    converter.cpp
+    converter.cpp \
+    threadpool.cpp \
+    ocrenginepool.cpp \
+    pagestream.cpp \
+    pdfdocument.cpp \
+    mappedfile.cpp \
+    preprocess.cpp \
+    pageworkspace.cpp \
+    projection.cpp \
+    tablegrid.cpp \
+    layoutcache.cpp \
+    ocrcache.cpp \
+    textnormalizer.cpp \
+    densetable.cpp \
+    csvwriter.cpp \
+    cellstore.cpp \
+    batch.cpp
 
 HEADERS += \
     settings.h \
     segmentation.h \
     imagefromfile.h \
+    imagefrommemory.h \
     ocr.h \
-    converter.h
+    converter.h \
+    job.h \
+    threadpool.h \
+    ocrenginepool.h \
+    boundedqueue.h \
+    pagestream.h \
+    pdfdocument.h \
+    mappedfile.h \
+    preprocess.h \
+    pageworkspace.h \
+    projection.h \
+    tablegrid.h \
+    layoutcache.h \
+    ocrcache.h \
+    textnormalizer.h \
+    densetable.h \
+    csvwriter.h \
+    csvformat.h \
+    cellstore.h \
+    batch.h
 
 
 macx: LIBS += -L$$PWD/../../../../usr/local/Cellar/tesseract/3.05.00/lib/ -ltesseract.3
@@ -0,0 +1,161 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fstream>
+#include <glob.h>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sys/stat.h>
+
+namespace
+{
+  bool IsDirectory(const std::string &path)
+  {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+  }
+
+  bool IsPdf(const std::string &name)
+  {
+    if(name.size() < 4)
+      return false;
+    std::string ext = name.substr(name.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".pdf";
+  }
+
+  std::string Trim(const std::string &line)
+  {
+    const size_t first = line.find_first_not_of(" \t\r");
+    if(first == std::string::npos)
+      return std::string();
+    return line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+  }
+
+  // One line of a field: no color codes of error messages, no tabs and line breaks
+  std::string Field(const std::string &text)
+  {
+    std::string field;
+    for(size_t i = 0; i < text.size(); ++i)
+    {
+      if(text[i] == '\033')
+      {
+        while(i < text.size() && text[i] != 'm')
+          ++i;
+        continue;
+      }
+      field += (text[i] == '\t' || text[i] == '\n' || text[i] == '\r') ? ' ' : text[i];
+    }
+    return Trim(field);
+  }
+}
+
+bool IsBatchSource(const std::string &source)
+{
+  return (!source.empty() && source[0] == '@') || source.find_first_of("*?[") != std::string::npos || \
+         IsDirectory(source);
+}
+
+std::vector<std::string> ListDocuments(const std::string &source)
+{
+  std::vector<std::string> documents;
+
+  if(!source.empty() && source[0] == '@')
+  {
+    std::ifstream manifest(source.substr(1));
+    std::string line;
+    while(std::getline(manifest, line))
+    {
+      line = Trim(line);
+      if(!line.empty() && line[0] != '#')
+        documents.push_back(line);
+    }
+    return documents;
+  }
+
+  if(IsDirectory(source))
+  {
+    if(DIR * dir = opendir(source.c_str()))
+    {
+      while(struct dirent * entry = readdir(dir))
+      {
+        const std::string path = source + "/" + entry->d_name;
+        if(IsPdf(entry->d_name) && !IsDirectory(path))
+          documents.push_back(path);
+      }
+      closedir(dir);
+    }
+  }
+  else if(source.find_first_of("*?[") != std::string::npos)
+  {
+    glob_t found;
+    if(glob(source.c_str(), GLOB_MARK, nullptr, &found) == 0)
+    {
+      // Directories are marked with trailing slash
+      for(size_t i = 0; i < found.gl_pathc; ++i)
+      {
+        const std::string path = found.gl_pathv[i];
+        if(path.back() != '/')
+          documents.push_back(path);
+      }
+    }
+    globfree(&found);
+  }
+  else
+  {
+    documents.push_back(source);
+  }
+
+  std::sort(documents.begin(), documents.end());
+  return documents;
+}
+
+std::vector<std::string> OutputNames(const std::vector<std::string> &documents)
+{
+  auto fileName = [](const std::string &path) { return path.substr(path.rfind('/') + 1); };
+
+  std::map<std::string, int> counts;
+  for(const std::string &path : documents)
+    ++counts[fileName(path)];
+
+  std::vector<std::string> names;
+  std::set<std::string> taken;
+  for(size_t i = 0; i < documents.size(); ++i)
+  {
+    std::string name = fileName(documents[i]);
+    if(counts[name] > 1)
+    {
+      // "a/report.pdf" -> "a_report.pdf"
+      name = documents[i];
+      while(name.compare(0, 2, "./") == 0)
+        name.erase(0, 2);
+      name.erase(0, name.find_first_not_of('/'));
+      std::replace(name.begin(), name.end(), '/', '_');
+    }
+    if(!taken.insert(name).second)
+    {
+      name += "_" + std::to_string(i + 1);
+      taken.insert(name);
+    }
+    names.push_back(name);
+  }
+  return names;
+}
+
+bool WriteSummary(const std::string &fileName, const std::vector<DocumentResult> &results)
+{
+  std::ofstream file(fileName);
+  if(!file.is_open())
+    return false;
+
+  file << std::fixed << std::setprecision(3);
+  file << "document\toutput\tpages\tcells\tseconds\tstatus\n";
+  for(const DocumentResult &result : results)
+  {
+    file << Field(result.path) << '\t' << Field(result.outName) << '\t' << result.pages << '\t' << result.cells << '\t' \
+         << result.seconds << '\t' << Field(result.status) << '\n';
+  }
+  return static_cast<bool>(file);
+}
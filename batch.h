@@ -0,0 +1,34 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+// Outcome of one document of a batch, a line of the summary file
+struct DocumentResult
+{
+  std::string path;
+  std::string outName; // name of its output files
+  int pages = 0; // pages processed
+  long long cells = 0; // recognized non-blank cells
+  double seconds = 0;
+  std::string status = "ok";
+};
+
+/* Documents of a batch run.
+ * Source is a directory (its *.pdf files), a glob pattern or @file with a
+ * path per line; '#' starts a comment line of the manifest. Any other
+ * source is a single document. Paths are sorted, except manifest ones.
+ */
+bool IsBatchSource(const std::string &source);
+std::vector<std::string> ListDocuments(const std::string &source);
+
+// Names of the outputs of every document: its file name, unless another document of the
+// batch has the same one; then directories of the path are joined into it with '_', and a
+// name still taken gets the number of the document appended
+std::vector<std::string> OutputNames(const std::vector<std::string> &documents);
+
+// Tab-separated summary: header, then a line per document
+bool WriteSummary(const std::string &fileName, const std::vector<DocumentResult> &results);
+
+#endif // BATCH_H
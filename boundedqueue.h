@@ -0,0 +1,69 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/* Blocking FIFO queue with fixed capacity.
+ * Push blocks while the queue is full, which gives backpressure to the
+ * producer. Pop blocks while it is empty and returns false once the queue
+ * is closed and drained.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(size_t capacity): m_capacity(capacity ? capacity : 1) {}
+
+  // Returns false if the queue was closed meanwhile, item is moved only when queued
+  bool Push(T &&item)
+  {
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_notFull.wait(guard, [this]{ return m_items.size() < m_capacity || m_closed; });
+    if(m_closed)
+      return false;
+
+    m_items.push_back(std::move(item));
+    guard.unlock();
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  bool Pop(T &item)
+  {
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_notEmpty.wait(guard, [this]{ return !m_items.empty() || m_closed; });
+    if(m_items.empty())
+      return false;
+
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    guard.unlock();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  // No more items will be pushed, wake up everybody
+  void Close()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_closed = true;
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+  }
+
+private:
+  const size_t m_capacity;
+  std::deque<T> m_items;
+  bool m_closed = false;
+
+  std::mutex m_lock;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+};
+
+#endif // BOUNDEDQUEUE_H
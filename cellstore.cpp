@@ -0,0 +1,114 @@
+#include "cellstore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+
+namespace
+{
+  enum ColumnType {Int32, UInt64, Bytes};
+
+  // Little-endian whatever the host is
+  void Put32(std::string &out, uint32_t v)
+  {
+    for(int i = 0; i < 4; ++i)
+      out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+  }
+
+  void Put64(std::string &out, uint64_t v)
+  {
+    for(int i = 0; i < 8; ++i)
+      out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+  }
+
+  void Align8(std::string &out)
+  {
+    out.append((8 - out.size() % 8) % 8, '\0');
+  }
+
+  struct Column
+  {
+    const char * name;
+    ColumnType type;
+    std::string data;
+  };
+}
+
+void CellStore::AddPage(int page, std::vector<Cell> cells)
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_entries.reserve(m_entries.size() + cells.size());
+  for(Cell &cell : cells)
+    m_entries.push_back(Entry{page, std::move(cell)});
+}
+
+size_t CellStore::Size() const
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_entries.size();
+}
+
+bool CellStore::Save(const std::string &fileName) const
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  // Pages come from workers in any order
+  std::vector<const Entry *> entries;
+  for(const Entry &entry : m_entries)
+    entries.push_back(&entry);
+  std::sort(entries.begin(), entries.end(), [](const Entry *a, const Entry *b)
+  {
+    return std::make_tuple(a->page, a->cell.row, a->cell.col) < std::make_tuple(b->page, b->cell.row, b->cell.col);
+  });
+
+  std::vector<Column> columns = {{"page", Int32, {}}, {"row", Int32, {}}, {"col", Int32, {}}, \
+                                 {"x", Int32, {}}, {"y", Int32, {}}, {"width", Int32, {}}, {"height", Int32, {}}, \
+                                 {"confidence", Int32, {}}, {"text_offsets", UInt64, {}}, {"text_heap", Bytes, {}}};
+
+  std::string &heap = columns[9].data;
+  for(const Entry * entry : entries)
+  {
+    const Cell &cell = entry->cell;
+    const int values[8] = {entry->page, cell.row, cell.col, cell.rect.x, cell.rect.y, \
+                           cell.rect.width, cell.rect.height, cell.confidence};
+    for(int i = 0; i < 8; ++i)
+      Put32(columns[i].data, static_cast<uint32_t>(values[i]));
+    Put64(columns[8].data, heap.size());
+    heap += cell.text;
+  }
+  Put64(columns[8].data, heap.size());
+
+  // Header and directory first, then columns at offsets known from their sizes
+  std::string out;
+  out.append("P2CCELLS", 8);
+  Put32(out, 1);
+  Put32(out, columns.size());
+  Put64(out, entries.size());
+  Put64(out, heap.size());
+
+  uint64_t offset = out.size() + 40 * columns.size();
+  for(const Column &column : columns)
+  {
+    char name[16] = {};
+    std::strncpy(name, column.name, sizeof(name) - 1);
+    out.append(name, sizeof(name));
+    Put32(out, column.type);
+    Put32(out, 0);
+    Put64(out, offset);
+    Put64(out, column.data.size());
+    offset += (column.data.size() + 7) / 8 * 8;
+  }
+
+  for(const Column &column : columns)
+  {
+    out += column.data;
+    Align8(out);
+  }
+
+  std::FILE * file = std::fopen(fileName.c_str(), "wb");
+  if(!file)
+    return false;
+  const bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+  return std::fclose(file) == 0 && written;
+}
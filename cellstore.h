@@ -0,0 +1,69 @@
+#ifndef CELLSTORE_H
+#define CELLSTORE_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Recognized cells of a whole document in one columnar binary file.
+ * Consumers map the file and read columns in place, nothing is parsed.
+ * All numbers are little-endian, every column starts at a multiple of 8.
+ *
+ *   header, 32 bytes:
+ *     char[8]  magic "P2CCELLS"
+ *     uint32   version, 1
+ *     uint32   number of columns
+ *     uint64   number of cells N
+ *     uint64   size of text heap in bytes
+ *   column directory, 40 bytes per column:
+ *     char[16] name, zero padded
+ *     uint32   type: 0 - int32, 1 - uint64, 2 - bytes
+ *     uint32   reserved, 0
+ *     uint64   offset of column from file start
+ *     uint64   size of column in bytes
+ *   columns:
+ *     page, row, col        int32 x N, page counts from 0
+ *     x, y, width, height   int32 x N, cell box on the cropped page of working size
+ *     confidence            int32 x N, mean OCR confidence 0..100, -1 unknown
+ *     text_offsets          uint64 x (N + 1), text of cell i is heap[offsets[i], offsets[i + 1])
+ *     text_heap             bytes, UTF-8 texts back to back
+ *
+ * Cells are sorted by page, row and col. Pages add their cells from any
+ * worker thread, the file is written by Save after the last page.
+ */
+class CellStore
+{
+public:
+  // Cell of a page as it goes into the file
+  struct Cell
+  {
+    int row;
+    int col;
+    cv::Rect rect;
+    int confidence;
+    std::string text;
+  };
+
+  // Keep recognized cells of page
+  void AddPage(int page, std::vector<Cell> cells);
+
+  // Write all cells, false on failure
+  bool Save(const std::string &fileName) const;
+
+  size_t Size() const;
+
+private:
+  struct Entry
+  {
+    int page;
+    Cell cell;
+  };
+
+  mutable std::mutex m_lock;
+  std::vector<Entry> m_entries;
+};
+
+#endif // CELLSTORE_H
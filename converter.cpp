@@ -1,171 +1,378 @@
 #include "converter.h"
+#include "pdfdocument.h"
+#include "settings.h"
 
-Converter::Converter(const std::string &inputFile, const std::string &outputFile, const int &dpi):
+// Display device renders 8 bit BGR rows top first, ready to wrap as CV_8UC3
+static const unsigned int displayFormat = DISPLAY_COLORS_RGB | DISPLAY_ALPHA_NONE | DISPLAY_DEPTH_8 | \
+                                          DISPLAY_LITTLEENDIAN | DISPLAY_TOPFIRST | DISPLAY_ROW_ALIGN_DEFAULT;
+
+namespace
+{
+  /* Ghostscript instance of the process.
+   * The interpreter started for single page rendering keeps running from
+   * document to document, each document is only opened and closed in it.
+   * Display callbacks get the session as handle and pass the page on to
+   * the converter that is rendering now.
+   */
+  struct GsSession
+  {
+    void * inst = nullptr;
+    bool started = false; // arguments were given, interpreter is running
+    bool broken = false; // interpreter quit or failed, replace it before next use
+    Converter * current = nullptr;
+
+    ~GsSession() { Stop(); }
+
+    // Create instance if there is none, false on failure
+    bool Start()
+    {
+      if(inst)
+        return true;
+      if(gsapi_new_instance(&inst, nullptr) < 0)
+      {
+        inst = nullptr;
+        return false;
+      }
+      if(gsapi_set_arg_encoding(inst, GS_ARG_ENCODING_UTF8) != 0)
+      {
+        gsapi_delete_instance(inst);
+        inst = nullptr;
+        return false;
+      }
+      return true;
+    }
+
+    void Stop()
+    {
+      if(!inst)
+        return;
+      // Only one instance may exist in the process, it is deleted even if the interpreter failed
+      gsapi_exit(inst);
+      gsapi_delete_instance(inst);
+      inst = nullptr;
+      started = false;
+      broken = false;
+    }
+  };
+
+  GsSession & Session()
+  {
+    static GsSession session;
+    return session;
+  }
+}
+
+display_callback Converter::m_displayCallback =
+{
+  sizeof(display_callback),
+  DISPLAY_VERSION_MAJOR,
+  DISPLAY_VERSION_MINOR,
+  &Converter::DisplayOpen,
+  &Converter::DisplayPreclose,
+  &Converter::DisplayClose,
+  &Converter::DisplayPresize,
+  &Converter::DisplaySize,
+  &Converter::DisplaySync,
+  &Converter::DisplayPage,
+  nullptr, // update
+  nullptr, // memalloc
+  nullptr, // memfree
+  nullptr  // separation
+};
+
+Converter::Converter(const std::string &inputFile, const int &dpi):
   m_inputFile(inputFile), \
-  m_outputFile("-sOutputFile=" + outputFile + GetFilename(m_inputFile).c_str() + "_" + "page_%d.png"), \
-  m_dpi("-r" + std::to_string(dpi) )
+  m_dpi("-r" + std::to_string(dpi) ), \
+  m_resolution(dpi), \
+  m_pdf(new PdfDocument(inputFile))
 {
-  InitArgv();
-  m_instCode = gsapi_new_instance(&m_inst, nullptr); //get instance of gs
-  if (m_instCode < 0)
-    throw std::bad_alloc();
-  else
-    m_instCode = gsapi_set_arg_encoding(m_inst, GS_ARG_ENCODING_UTF8); //get instance code
+  // Instance of the previous document is reused unless it failed
+  GsSession &session = Session();
+  if(session.broken)
+    session.Stop();
+  if(!session.Start())
+    throw std::runtime_error(std::string(RED) + std::string("Fail! Ghostscript interpreter is unusable! \n") + std::string(RESET));
 
   if(!IsRaster())
     throw std::invalid_argument(std::string(RED) + std::string("Fail! PDF file is not raster! \n") + std::string(RESET));
+
+  session.current = this;
 }
 
 Converter::~Converter()
 {
-  RemoveFiles();
-  m_exitCode = gsapi_exit(m_inst);
-  if ((m_exitCode == 0) || (m_exitCode == gs_error_Quit))
+  // Ghostscript is released at process exit, next document reuses it
+  GsSession &session = Session();
+  if(m_pdfOpen)
   {
-    gsapi_delete_instance(m_inst);
+    int exitCode = 0;
+    if(gsapi_run_string(session.inst, "runpdfend\n", 0, &exitCode) < 0)
+      session.broken = true;
   }
+  if(session.current == this)
+    session.current = nullptr;
 }
 
-bool Converter::ToPNG()
+bool Converter::Render(const PageHandler &handler)
 {
-  if (m_instCode == 0)
+  if(!m_pdf->IsValid())
+    return RenderDocument(handler);
+
+  const int last = m_lastPage < 0 ? m_pdf->PageCount() - 1 : std::min(m_lastPage, m_pdf->PageCount() - 1);
+
+  bool status = 0;
+  for(int page = m_firstPage; page <= last; ++page)
   {
-    gsapi_init_with_args(m_inst, m_gsargc, m_gsargv); // start process
-    return 0;
+    if(m_pdf->Kind(page) == PdfDocument::Vector)
+    {
+      std::cout << YELLOW << "Page " << page << " has no images, skipped" << RESET << std::endl;
+      continue;
+    }
+
+    // Scan image of the page at native resolution, Ghostscript for anything else
+    cv::Mat image;
+    if(settings::extractImages && m_pdf->ExtractPageImage(page, image, WorkingSize(page)))
+    {
+      try
+      {
+        handler(page, image);
+      }
+      catch(std::exception const &ex)
+      {
+        std::cerr << RED << "Caught exception while processing page " << page << ": " << ex.what() << RESET << std::endl;
+      }
+    }
+    else
+    {
+      std::cout << "Page " << page << " is rendered by Ghostscript" << std::endl;
+      status |= RenderPage(page, handler);
+    }
   }
-  return 1;
+
+  if(m_pdfOpen)
+  {
+    int exitCode = 0;
+    if(gsapi_run_string(Session().inst, "runpdfend\n", 0, &exitCode) < 0)
+      Session().broken = true;
+    m_pdfOpen = false;
+  }
+
+  return status;
 }
 
-const std::string Converter::GetPath() const
+bool Converter::RenderDocument(const PageHandler &handler)
 {
-  size_t lastSlash = m_outputFile.find_last_of("/");
-  size_t firstSlash = m_outputFile.find("/");
-  return m_outputFile.substr(firstSlash, m_outputFile.length() - firstSlash - (m_outputFile.length() - lastSlash));
+  m_pageHandler = handler;
+  m_pageCount = m_firstPage;
+
+  std::vector<std::string> args = DisplayArgs();
+  if(m_firstPage > 0)
+    args.push_back("-dFirstPage=" + std::to_string(m_firstPage + 1));
+  if(m_lastPage >= 0)
+    args.push_back("-dLastPage=" + std::to_string(m_lastPage + 1));
+
+  InitArgv(args, true);
+  const int code = RunArgv(); // start process, pages arrive in DisplayPage
+  Session().broken = true; // interpreter quit after the file
+
+  m_pageHandler = nullptr;
+  return !(code == 0 || code == gs_error_Quit);
 }
 
-const std::vector<std::string> Converter::ListPages() const
+bool Converter::RenderPage(int page, const PageHandler &handler)
 {
-  std::vector<std::string> pages;
-  DIR *pDIR = nullptr;
-  struct dirent *entry = nullptr;
+  int exitCode = 0;
 
-  if((pDIR = opendir(GetPath().c_str())))
+  GsSession &session = Session();
+
+  if(!m_pdfOpen)
   {
-    while((entry = readdir(pDIR)))
+    // Start interpreter without input file once, then open PDF for single page rendering
+    if(!session.started)
     {
-      if(std::regex_match(entry->d_name, std::regex(GetFilename(m_inputFile) + "_page_[[:digit:]]{1,}.png"))){
-        pages.push_back(GetPath() + "/" + entry->d_name);}
+      InitArgv(DisplayArgs(), false);
+      if(RunArgv() < 0)
+      {
+        session.broken = true;
+        return 1;
+      }
     }
-    closedir(pDIR);
 
-    if (!pages.empty())
+    std::string path;
+    for(char c:m_inputFile)
     {
-      return pages;
+      if(c == '(' || c == ')' || c == '\\')
+        path.push_back('\\');
+      path.push_back(c);
     }
 
-    else
+    if(gsapi_run_string(session.inst, ("(" + path + ") (r) file runpdfbegin\n").c_str(), 0, &exitCode) < 0)
     {
-      std::cerr << RED << "Fail! Directory or PDF file does not contain images! \n" << RESET;
-      exit(1);
+      session.broken = true;
+      return 1;
     }
+    m_pdfOpen = true;
   }
-  return pages;
-}
 
-// Remove PNG files after recognize
-bool Converter::RemoveFiles() const
-{
-  std::vector<std::string> pages = ListPages();
-  for(auto page = pages.begin(); page != pages.end(); ++page)
+  // Resolution of each axis is chosen so that the raster already has the working size,
+  // otherwise it is set back to dpi after pages of previous documents
+  std::ostringstream command;
+  const cv::Size target = WorkingSize(page);
+  if(target.area() > 0)
   {
-    if( ::remove(page->c_str()) != 0 )
-    {
-      std::cerr << RED << "Error deleting file" << RESET << std::endl;
-      continue;
-    }
-    else
-    {
-      std::cout << GREEN << "File successfully deleted" << RESET << std::endl;
-    }
+    const cv::Size2d points = m_pdf->PageSize(page);
+    command << "<< /HWResolution [" << target.width * 72.0 / points.width << " " \
+            << target.height * 72.0 / points.height << "] >> setpagedevice ";
   }
-  return 0;
+  else
+  {
+    command << "<< /HWResolution [" << m_resolution << " " << m_resolution << "] >> setpagedevice ";
+  }
+  command << page + 1 << " pdfgetpage pdfshowpage\n";
+
+  m_pageHandler = handler;
+  m_pageCount = page;
+
+  const int code = gsapi_run_string(session.inst, command.str().c_str(), 0, &exitCode);
+
+  m_pageHandler = nullptr;
+  if(code < 0)
+    session.broken = true;
+  return code < 0;
 }
 
-void Converter::InitArgv()
+cv::Size Converter::WorkingSize(int page) const
 {
-  // Set options
-  m_gsargv[0] = const_cast<char*>("ps2pdf");
-  std::cout<<m_gsargv[0]<<std::endl;
+  const cv::Size2d points = m_pdf->PageSize(page);
+  if(!settings::renderWorkingSize || points.width <= 0 || points.height <= 0)
+    return cv::Size();
 
-  m_gsargv[1] = const_cast<char*>("-q");
-  std::cout<<m_gsargv[1]<<std::endl;
-
-  m_gsargv[2] = const_cast<char*>("-dNOPAUSE");
-  std::cout<<m_gsargv[2]<<std::endl;
+  const cv::Size size(settings::width * m_renderScale, settings::height * m_renderScale);
+  return points.width > points.height ? size : cv::Size(size.height, size.width);
+}
 
-  m_gsargv[3] = const_cast<char*>("-sDEVICE=png16m");
-  std::cout<<m_gsargv[3]<<std::endl;
+std::vector<std::string> Converter::DisplayArgs() const
+{
+  std::stringstream handle;
+  handle << "-sDisplayHandle=16#" << std::hex << reinterpret_cast<uintptr_t>(&Session());
 
-  m_gsargv[4] = const_cast<char*>(m_dpi.c_str());
-  std::cout<<m_gsargv[4]<<std::endl;
+  return {"-sDEVICE=display", "-dDisplayFormat=" + std::to_string(displayFormat), handle.str()};
+}
 
-  m_gsargv[5] = const_cast<char*>(m_outputFile.c_str());
-  std::cout<<m_gsargv[5]<<std::endl;
+int Converter::RunArgv()
+{
+  std::vector<char *> argv;
+  for(auto &arg:m_gsargs)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+
+  // Arguments are taken once per instance, a running interpreter is replaced
+  GsSession &session = Session();
+  if(session.started)
+    session.Stop();
+  if(!session.Start())
+    return -1;
+
+  gsapi_set_display_callback(session.inst, &m_displayCallback);
+  session.started = true;
+  return gsapi_init_with_args(session.inst, argv.size(), argv.data());
+}
 
-  m_gsargv[6] = const_cast<char*>(m_inputFile.c_str());
-  std::cout<<m_gsargv[6]<<std::endl;
+int Converter::DisplayOpen(void *, void *)
+{
+  return 0;
+}
 
-  m_gsargv[7] = const_cast<char*>("-c");
-  std::cout<<m_gsargv[7]<<std::endl;
+int Converter::DisplayPreclose(void *, void *)
+{
+  return 0;
+}
 
-  m_gsargv[8] = const_cast<char*>("quit");
-  std::cout<<m_gsargv[8]<<std::endl;
+int Converter::DisplayClose(void *, void *)
+{
+  return 0;
 }
 
-// PDF file is a raster?
-bool Converter::IsRaster() const
+int Converter::DisplayPresize(void *, void *, int, int, int, unsigned int format)
 {
-  std::ifstream in(m_inputFile, std::ios::binary);
-  char * fileBuf = nullptr;
-  const char * imgByte = "496d616765";
-  bool status = false;
+  return format == displayFormat ? 0 : -1;
+}
 
-  if(in.is_open())
-  {
-    std::cout<<"File is open"<<std::endl;
-    in.seekg (0, in.end); // Set cursor at the end
-    const int length = in.tellg(); // Calculate size of file
-    in.seekg (0, in.beg); // Set cursor at the begin
+int Converter::DisplaySize(void *handle, void *, int width, int height, int raster, unsigned int, unsigned char *pimage)
+{
+  Converter * conv = static_cast<GsSession *>(handle)->current;
+  if(!conv)
+    return 0;
+  conv->m_pageBuffer = pimage;
+  conv->m_pageWidth = width;
+  conv->m_pageHeight = height;
+  conv->m_pageRaster = raster;
+  return 0;
+}
 
-    fileBuf = new char[length]; // Create buffer for the first 200 bytes
-    in.read(fileBuf, 10000); // Read first 10000 bytes
+int Converter::DisplaySync(void *, void *)
+{
+  return 0;
+}
 
-    in.close(); // Close file
+int Converter::DisplayPage(void *handle, void *, int, int)
+{
+  Converter * conv = static_cast<GsSession *>(handle)->current;
+  if(!conv)
+    return 0;
 
-    std::stringstream bytes;
+  if(!conv->m_pageBuffer || !conv->m_pageHandler)
+    return 0;
 
-    // Write first 10000 bytes
-    for (int i = 0; i < 10000; ++i)
-    {
-      bytes << std::hex << std::setw(2) << std::setfill('0')
-            << (int)fileBuf[i];
-    }
+  // Wrap buffer of display device without copying
+  const cv::Mat page(conv->m_pageHeight, conv->m_pageWidth, CV_8UC3, conv->m_pageBuffer, conv->m_pageRaster);
 
-    int posFind = bytes.str().find(imgByte);
+  try
+  {
+    conv->m_pageHandler(conv->m_pageCount, page);
+  }
+  catch(std::exception const &ex)
+  {
+    std::cerr << RED << "Caught exception while processing page " << conv->m_pageCount << ": " << ex.what() << RESET << std::endl;
+  }
 
-    if(posFind != -1)
-      status =  true;
+  conv->m_pageCount++;
+  return 0;
+}
 
-    /*std::cout << bytes.str() <<std::endl;*/
+int Converter::PageCount() const
+{
+  return m_pdf->IsValid() ? m_pdf->PageCount() : -1;
+}
 
-    std::cout <<"Found at "<< posFind <<std::endl;
+void Converter::SetPageRange(int first, int last)
+{
+  m_firstPage = std::max(0, first);
+  m_lastPage = last;
+}
 
-    delete [] fileBuf;
-    fileBuf = nullptr;
-  }
+void Converter::InitArgv(const std::vector<std::string> &device, bool withInput)
+{
+  // Set options
+  m_gsargs = {"ps2pdf", "-q", "-dNOPAUSE"};
+  m_gsargs.insert(m_gsargs.end(), device.begin(), device.end());
+  m_gsargs.push_back(m_dpi);
+  if(withInput)
+    m_gsargs.insert(m_gsargs.end(), {m_inputFile, "-c", "quit"});
+}
 
-  else
+// PDF file is a raster?
+bool Converter::IsRaster() const
+{
+  if(!m_pdf->IsOpen())
     throw std::invalid_argument(std::string(RED) + "Error opening file\n" + std::string(RESET));
 
-  return status;
+  if(m_pdf->IsValid())
+  {
+    std::cout << "Pages: " << m_pdf->PageCount() \
+              << " (raster " << m_pdf->CountPages(PdfDocument::Raster) \
+              << ", mixed " << m_pdf->CountPages(PdfDocument::Mixed) \
+              << ", vector " << m_pdf->CountPages(PdfDocument::Vector) << ")" << std::endl;
+  }
+
+  return m_pdf->HasImages();
 }
@@ -5,14 +5,19 @@
 #include <sstream>
 #include <vector>
 #include <iostream>
-#include <fstream>
-#include <iomanip>
 #include <unistd.h>
-#include <regex>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+#include "opencv2/imgproc/imgproc.hpp"
 
 #include "ghostscript/iapi.h"
 #include "ghostscript/ierrors.h"
-#include "dirent.h"
+#include "ghostscript/gdevdsp.h"
+
+class PdfDocument;
 
 #define RESET   "\033[0m"
 #define BLACK   "\033[30m"      /* Black */
@@ -24,17 +29,28 @@ class Converter
 {
 public:
 
+  // Called for every rendered page, image is valid only during the call
+  typedef std::function<void(int pageNum, const cv::Mat &page)> PageHandler;
+
   Converter() = delete;
 
   // Default constructor
-  Converter(const std::string &inputFile, const std::string &outputFile, const int &dpi);
+  Converter(const std::string &inputFile, const int &dpi);
 
   ~Converter();
 
-  // Split PDF file to images
-  bool ToPNG();
+  // Number of pages from the PDF structure, -1 if it could not be parsed
+  int PageCount() const;
+
+  // Render pages scale times bigger than the working size
+  void SetRenderScale(int scale) { m_renderScale = std::max(1, scale); }
 
-  const std::vector<std::string> ListPages() const;
+  // Render only pages from first to last (zero-based, inclusive), last < 0 means until the end
+  void SetPageRange(int first, int last);
+
+  // Render PDF file page by page into memory, without temporary files.
+  // Pages made of a single scan image are decoded directly at native resolution
+  bool Render(const PageHandler &handler);
 
   // Extract filename from path
   static const std::string GetFilename(const std::string& str)
@@ -47,28 +63,60 @@ public:
 
 private:
   const std::string m_inputFile;
-  const std::string m_outputFile;
   const std::string m_dpi;
+  const int m_resolution;
 
-  void * m_inst = nullptr;
+  // Index of PDF structure, built once
+  std::unique_ptr<PdfDocument> m_pdf;
 
-  char * m_gsargv[10] = {}; //array with args
-  const int m_gsargc = 9;
+  int m_firstPage = 0;
+  int m_lastPage = -1;
+  int m_renderScale = 1;
 
-  int m_instCode = 0;
-  int m_exitCode = 0;
+  std::vector<std::string> m_gsargs; //array with args
 
-  // Initialize array with args
-  void InitArgv();
+  // Display device state
+  PageHandler m_pageHandler;
+  unsigned char * m_pageBuffer = nullptr;
+  int m_pageWidth = 0;
+  int m_pageHeight = 0;
+  int m_pageRaster = 0;
+  int m_pageCount = 0;
 
-  // PDF file is raster?
-  bool IsRaster () const;
+  static display_callback m_displayCallback;
+
+  // Interpreter was started without input file and PDF is open for single pages
+  bool m_pdfOpen = false;
 
-  // Extract path until PDF file
-  const std::string GetPath() const;
+  // Initialize array with args for output device, optionally with input file
+  void InitArgv(const std::vector<std::string> &device, bool withInput);
 
-  // Remove png files after conversation
-  bool RemoveFiles() const;
+  // Args of display device that calls back this object
+  std::vector<std::string> DisplayArgs() const;
+
+  // Render whole document by Ghostscript
+  bool RenderDocument(const PageHandler &handler);
+
+  // Render single page by Ghostscript, the interpreter stays open for next pages
+  bool RenderPage(int page, const PageHandler &handler);
+
+  // Size pages are rendered at: working size times render scale, oriented as the page; empty if unknown or disabled
+  cv::Size WorkingSize(int page) const;
+
+  // Run Ghostscript with args
+  int RunArgv();
+
+  // Callbacks of display device, handle is pointer to Converter
+  static int DisplayOpen(void *handle, void *device);
+  static int DisplayPreclose(void *handle, void *device);
+  static int DisplayClose(void *handle, void *device);
+  static int DisplayPresize(void *handle, void *device, int width, int height, int raster, unsigned int format);
+  static int DisplaySize(void *handle, void *device, int width, int height, int raster, unsigned int format, unsigned char *pimage);
+  static int DisplaySync(void *handle, void *device);
+  static int DisplayPage(void *handle, void *device, int copies, int flush);
+
+  // PDF file is raster?
+  bool IsRaster () const;
 
 };
 
@@ -0,0 +1,13 @@
+#ifndef CSVFORMAT_H
+#define CSVFORMAT_H
+
+#include <string>
+
+// Separators of CSV files
+struct CsvFormat
+{
+  std::string delimiter = ",";
+  std::string lineEnd = "\n";
+};
+
+#endif // CSVFORMAT_H
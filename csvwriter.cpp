@@ -0,0 +1,128 @@
+#include "csvwriter.h"
+#include "converter.h"
+
+#include <cstdio>
+
+namespace
+{
+  void AppendField(const std::string &field, const CsvFormat &format, std::string &text)
+  {
+    if(field.find(format.delimiter) == std::string::npos && field.find_first_of("\"\r\n") == std::string::npos)
+    {
+      text += field;
+      return;
+    }
+
+    text.push_back('"');
+    for(char c : field)
+    {
+      if(c == '"')
+        text.push_back('"');
+      text.push_back(c);
+    }
+    text.push_back('"');
+  }
+}
+
+CsvWriter::CsvWriter(const CsvFormat &format, size_t depth):
+  m_format(format), m_queue(depth)
+{
+  m_writer = std::thread(&CsvWriter::Consume, this);
+}
+
+CsvWriter::~CsvWriter()
+{
+  Close();
+}
+
+void CsvWriter::Close()
+{
+  m_queue.Close();
+  if(m_writer.joinable())
+    m_writer.join();
+}
+
+void CsvWriter::Write(const std::string &fileName, const DenseTable &table)
+{
+  CsvFile file;
+  file.name = fileName;
+  Format(table, m_format, file.text);
+
+  // Closed writer leaves the file to the caller's thread, text is formatted already
+  if(!m_queue.Push(std::move(file)))
+  {
+    if(WriteFile(fileName, file.text))
+    {
+      ++m_written;
+      m_bytes += file.text.size();
+    }
+    else
+    {
+      ++m_failed;
+      std::cerr << RED << "Can't write " << fileName << RESET << std::endl;
+    }
+  }
+}
+
+void CsvWriter::Format(const DenseTable &table, const CsvFormat &format, std::string &text)
+{
+  size_t lines = 0; // line breaks not written yet
+
+  for(const auto &row : table.Rows())
+  {
+    size_t col = 0;
+    bool first = true;
+    for(size_t x = 0; x < row.size(); ++x)
+    {
+      if(row[x].empty())
+        continue;
+
+      // Rows before the first cell of this one end only when something follows them
+      if(first)
+      {
+        for(; lines > 0; --lines)
+          text += format.lineEnd;
+        first = false;
+      }
+      for(; col < x; ++col)
+        text += format.delimiter;
+      AppendField(row[x], format, text);
+    }
+    ++lines;
+  }
+}
+
+bool CsvWriter::WriteFile(const std::string &fileName, const std::string &text)
+{
+  std::FILE * file = std::fopen(fileName.c_str(), "wb");
+  if(!file)
+    return false;
+
+  // Text is one block already, stdio buffer is not needed
+  std::setvbuf(file, nullptr, _IONBF, 0);
+  const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+  return std::fclose(file) == 0 && written;
+}
+
+void CsvWriter::Consume()
+{
+  CsvFile file;
+  while(m_queue.Pop(file))
+  {
+    if(WriteFile(file.name, file.text))
+    {
+      ++m_written;
+      m_bytes += file.text.size();
+    }
+    else
+    {
+      ++m_failed;
+      std::cerr << RED << "Can't write " << file.name << RESET << std::endl;
+    }
+  }
+}
+
+void CsvWriter::Report(std::ostream &out) const
+{
+  out << "CSV files written: " << m_written << " (" << m_bytes << " bytes), failed: " << m_failed << std::endl;
+}
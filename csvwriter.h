@@ -0,0 +1,62 @@
+#ifndef CSVWRITER_H
+#define CSVWRITER_H
+
+#include "boundedqueue.h"
+#include "csvformat.h"
+#include "densetable.h"
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/* Writes CSV files of pages on a background thread.
+ * Tables are formatted on the calling worker (RFC 4180 quoting: a field
+ * holding the delimiter, a quote, CR or LF is quoted and its quotes are
+ * doubled) into one block, which the I/O thread writes with a single call.
+ * At most depth files wait in the queue, then Write blocks. The last row
+ * has no line break.
+ */
+class CsvWriter
+{
+public:
+  CsvWriter(const CsvFormat &format, size_t depth);
+  ~CsvWriter();
+
+  CsvWriter(const CsvWriter &) = delete;
+  CsvWriter & operator=(const CsvWriter &) = delete;
+
+  // Format table now, the file is written later by the I/O thread
+  void Write(const std::string &fileName, const DenseTable &table);
+
+  // Write all queued files and stop the I/O thread
+  void Close();
+
+  // Append table as CSV text
+  static void Format(const DenseTable &table, const CsvFormat &format, std::string &text);
+
+  // Write text as the whole file, false on failure
+  static bool WriteFile(const std::string &fileName, const std::string &text);
+
+  // Print written / failed counters
+  void Report(std::ostream &out) const;
+
+private:
+  struct CsvFile
+  {
+    std::string name;
+    std::string text;
+  };
+
+  const CsvFormat m_format;
+  BoundedQueue<CsvFile> m_queue;
+  std::thread m_writer;
+
+  std::atomic<int> m_written{0};
+  std::atomic<int> m_failed{0};
+  std::atomic<long long> m_bytes{0};
+
+  void Consume();
+};
+
+#endif // CSVWRITER_H
@@ -0,0 +1,30 @@
+#include "densetable.h"
+
+#include <utility>
+
+void DenseTable::Reserve(size_t rows, size_t cols)
+{
+  if(m_rows.size() < rows)
+    m_rows.resize(rows);
+  for(auto &row : m_rows)
+    row.reserve(cols);
+}
+
+void DenseTable::setCell(size_t x, size_t y, std::string str)
+{
+  if(str.empty())
+    return;
+
+  if(y >= m_rows.size())
+    m_rows.resize(y + 1);
+  std::vector<std::string> &row = m_rows[y];
+  if(x >= row.size())
+    row.resize(x + 1);
+  row[x] = std::move(str);
+}
+
+const std::string & DenseTable::At(size_t x, size_t y) const
+{
+  static const std::string empty;
+  return y < m_rows.size() && x < m_rows[y].size() ? m_rows[y][x] : empty;
+}
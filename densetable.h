@@ -0,0 +1,32 @@
+#ifndef DENSETABLE_H
+#define DENSETABLE_H
+
+#include <string>
+#include <vector>
+
+/* Recognized table of one page, stored row by row.
+ * Every row is a vector of its cells, so text is moved in at O(1) and the
+ * cells are iterated in order without sorting. Empty text is not stored.
+ * CsvWriter writes the table.
+ */
+class DenseTable
+{
+public:
+  // Allocate rows up front, every one with room for cols cells
+  void Reserve(size_t rows, size_t cols);
+
+  // Put text into column x of row y, replacing the previous one
+  void setCell(size_t x, size_t y, std::string str);
+
+  const std::string & At(size_t x, size_t y) const;
+
+  // Cells of every row, empty strings are missing cells
+  const std::vector<std::vector<std::string>> & Rows() const { return m_rows; }
+
+  void Clear() { m_rows.clear(); }
+
+private:
+  std::vector<std::vector<std::string>> m_rows;
+};
+
+#endif // DENSETABLE_H
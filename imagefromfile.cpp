@@ -1,7 +1,7 @@
 #include "imagefromfile.h"
 
-ImageFromFile::ImageFromFile(const std::string &fileName):
-    m_fileName(fileName)
+ImageFromFile::ImageFromFile(const std::string &fileName, const Job &job, int pageNum, PageWorkspace &workspace):
+    Segmentation(job, pageNum, workspace), m_fileName(fileName)
 {
   if(fileName.empty()){std::cerr << "Path is wrong or empty..!" <<std::endl;}
 }
@@ -6,7 +6,7 @@
 class ImageFromFile : public Segmentation
 {
 public:
-  ImageFromFile(const std::string &fileName);
+  ImageFromFile(const std::string &fileName, const Job &job, int pageNum, PageWorkspace &workspace);
 
 private:
   std::string m_fileName;
@@ -0,0 +1,12 @@
+#include "imagefrommemory.h"
+
+ImageFromMemory::ImageFromMemory(const cv::Mat &image, const Job &job, int pageNum, PageWorkspace &workspace):
+    Segmentation(job, pageNum, workspace), m_image(image)
+{
+  if(image.empty()){std::cerr << "Page image is empty..!" <<std::endl;}
+}
+
+cv::Mat ImageFromMemory::GetImage()
+{
+  return m_image;
+}
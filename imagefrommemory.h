@@ -0,0 +1,17 @@
+#ifndef IMAGEFROMMEMORY_H
+#define IMAGEFROMMEMORY_H
+
+#include "segmentation.h"
+
+// Page rendered into memory, the buffer is not copied
+class ImageFromMemory : public Segmentation
+{
+public:
+  ImageFromMemory(const cv::Mat &image, const Job &job, int pageNum, PageWorkspace &workspace);
+
+private:
+  cv::Mat m_image;
+  cv::Mat GetImage() override;
+};
+
+#endif // IMAGEFROMMEMORY_H
@@ -0,0 +1,48 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "csvformat.h"
+
+#include <atomic>
+#include <string>
+
+class ThreadPool;
+class TextNormalizer;
+class CsvWriter;
+class CellStore;
+
+// State of one document conversion, shared read-only by every page of it
+struct Job
+{
+  // Path until PDF file
+  std::string inPath;
+  // Name of the output files of the document, file name of inPath if empty
+  std::string outName;
+  // Path until destination folder
+  std::string outPath;
+  // Language recognition
+  std::string lang = "rus";
+  // Process pages as 8 bit gray, color is kept only in a thumbnail for stamp detection
+  bool gray = false;
+  // Pages are rendered ocrScale times bigger than the working size, grid is detected on
+  // the page downscaled to it and cells are recognized from the big one
+  int ocrScale = 1;
+  // Reuse grids of known forms from LayoutCache, store new ones
+  bool layouts = true;
+  // Always detect the grid, templates are only stored
+  bool redetect = false;
+  // Pool for recognizing the cells of one page in parallel, serial if null
+  ThreadPool * cellPool = nullptr;
+  // Filters of recognized text, built once per job; default ones if not set
+  const TextNormalizer * normalizer = nullptr;
+  // Separators of CSV files, used by the writer and by pages writing them themselves
+  CsvFormat csvFormat;
+  // Writes CSV files in background, pages write them themselves if null
+  CsvWriter * csvWriter = nullptr;
+  // Cells of all pages for the columnar file of the document, not collected if null
+  CellStore * cellStore = nullptr;
+  // Recognized non-blank cells of the document, not counted if null
+  std::atomic<long long> * cellCount = nullptr;
+};
+
+#endif // JOB_H
@@ -0,0 +1,294 @@
+#include "layoutcache.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+  // Bounds of a layout read from file, far above any real table
+  const int maxPageSide = 1 << 16;
+  const size_t maxBands = 4096;
+  const size_t maxColumns = 1024;
+
+  // Any ink within tolerance across the line at the sample point
+  bool InkAcross(const cv::Mat &binary, int x, int y, bool horizontalLine)
+  {
+    for(int d = -settings::layoutTolerance; d <= settings::layoutTolerance; ++d)
+    {
+      const int sx = horizontalLine ? x : x + d;
+      const int sy = horizontalLine ? y + d : y;
+      if(sx >= 0 && sy >= 0 && sx < binary.cols && sy < binary.rows && binary.at<uchar>(sy, sx))
+        return true;
+    }
+    return false;
+  }
+
+  struct Counter
+  {
+    long long inked = 0;
+    long long total = 0;
+
+    void Add(bool value) { inked += value; ++total; }
+    void Merge(const Counter &other) { inked += other.inked; total += other.total; }
+    double Ratio() const { return total ? static_cast<double>(inked) / total : 0; }
+  };
+}
+
+LayoutCache & LayoutCache::Instance()
+{
+  static LayoutCache cache;
+  return cache;
+}
+
+bool LayoutCache::Fits(const cv::Mat &binary, const Layout &layout)
+{
+  const int step = settings::layoutSampleStep;
+  // Vertical lines of a row band are short, they are sampled denser
+  const int verStep = std::max(1, step / 4);
+  // Far enough from the line to miss it with tolerance, near enough to stay in the cell
+  const int beside = settings::layoutTolerance * 2 + std::max(settings::sizeHor, settings::sizeVer);
+
+  // Every line of the template must be on the page on its own, a long line does not cover a missing one
+  auto lineFound = [](const Counter &line) { return line.Ratio() >= settings::layoutLineRatio; };
+
+  Counter horizontal, vertical, off;
+  int left = binary.cols, right = 0;
+  std::vector<int> rulings; // y of template lines
+  for(const GridBand &band : layout.bands)
+  {
+    const int bandLeft = band.xs.front();
+    const int bandRight = band.xs.back();
+    const bool roomY = band.bottom - band.top > 2 * beside;
+    left = std::min(left, bandLeft);
+    right = std::max(right, bandRight);
+    rulings.push_back(band.top);
+    rulings.push_back(band.bottom);
+
+    // Top and bottom lines, samples beside them go into the band
+    Counter top, bottom;
+    for(int x = bandLeft; x <= bandRight; x += step)
+    {
+      top.Add(InkAcross(binary, x, band.top, true));
+      bottom.Add(InkAcross(binary, x, band.bottom, true));
+      if(roomY)
+      {
+        off.Add(InkAcross(binary, x, band.top + beside, true));
+        off.Add(InkAcross(binary, x, band.bottom - beside, true));
+      }
+    }
+    if(!lineFound(top) || !lineFound(bottom))
+      return false;
+    horizontal.Merge(top);
+    horizontal.Merge(bottom);
+
+    // Vertical lines, samples beside them go into the cell on their right
+    for(size_t i = 0; i < band.xs.size(); ++i)
+    {
+      const int x = band.xs[i];
+      const bool roomX = i + 1 < band.xs.size() && band.xs[i + 1] - x > 2 * beside;
+      Counter line;
+      for(int y = band.top; y <= band.bottom; y += verStep)
+      {
+        line.Add(InkAcross(binary, x, y, false));
+        if(roomX && (y - band.top) % step == 0)
+          off.Add(InkAcross(binary, x + beside, y, false));
+      }
+      if(!lineFound(line))
+        return false;
+      vertical.Merge(line);
+    }
+  }
+
+  // Horizontal and vertical lines are scored apart, so long rulings do not hide the columns
+  if(horizontal.Ratio() < settings::layoutMatchRatio || vertical.Ratio() < settings::layoutMatchRatio || \
+     off.Ratio() > settings::layoutBesideRatio)
+    return false;
+
+  // Page must not have rulings the template lacks: more rows, a table going on below the template
+  const int margin = settings::layoutTolerance * 2 + settings::sizeHor;
+  for(int y = 0; y < binary.rows; y += settings::layoutTolerance)
+  {
+    auto near = [y, margin](int ruling) { return std::abs(y - ruling) <= margin; };
+    if(std::any_of(rulings.begin(), rulings.end(), near))
+      continue;
+
+    Counter row;
+    for(int x = left; x <= right; x += step)
+      row.Add(InkAcross(binary, x, y, true));
+    if(row.Ratio() >= settings::layoutMatchRatio)
+      return false;
+  }
+  return true;
+}
+
+bool LayoutCache::Same(const Layout &a, const Layout &b)
+{
+  if(a.pageSize != b.pageSize || a.bands.size() != b.bands.size())
+    return false;
+
+  auto near = [](int u, int v) { return std::abs(u - v) <= settings::layoutTolerance; };
+  for(size_t i = 0; i < a.bands.size(); ++i)
+  {
+    const GridBand &u = a.bands[i];
+    const GridBand &v = b.bands[i];
+    if(!near(u.top, v.top) || !near(u.bottom, v.bottom) || u.xs.size() != v.xs.size())
+      return false;
+    for(size_t j = 0; j < u.xs.size(); ++j)
+    {
+      if(!near(u.xs[j], v.xs[j]))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool LayoutCache::Match(const cv::Mat &binary, TableGrid &grid)
+{
+  std::vector<std::shared_ptr<const Layout>> layouts;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    layouts = m_layouts;
+  }
+
+  for(const auto &layout : layouts)
+  {
+    if(layout->pageSize != binary.size())
+      continue;
+
+    if(!Fits(binary, *layout))
+      continue;
+
+    grid.Clear();
+    for(const GridBand &band : layout->bands)
+      grid.AddRow(band.top, band.bottom, band.xs, settings::sizeHor, settings::sizeVer);
+
+    // Forms come in runs, the template just hit is tried first next time
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      auto it = std::find(m_layouts.begin(), m_layouts.end(), layout);
+      if(it != m_layouts.end())
+        std::rotate(m_layouts.begin(), it, it + 1);
+    }
+
+    ++m_hits;
+    return true;
+  }
+
+  ++m_misses;
+  return false;
+}
+
+void LayoutCache::Store(const TableGrid &grid, const cv::Size &pageSize)
+{
+  if(grid.Rows() == 0)
+    return;
+
+  std::shared_ptr<Layout> layout(new Layout{pageSize, grid.Bands()});
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  for(const auto &known : m_layouts)
+  {
+    if(Same(*known, *layout))
+      return;
+  }
+
+  m_layouts.insert(m_layouts.begin(), layout);
+  if(m_layouts.size() > static_cast<size_t>(settings::layoutCacheSize))
+    m_layouts.resize(settings::layoutCacheSize);
+}
+
+bool LayoutCache::Load(const std::string &fileName)
+{
+  std::ifstream file(fileName);
+  if(!file.is_open())
+    return false;
+
+  std::string magic, kind;
+  int version = 0;
+  if(!(file >> magic >> kind >> version) || magic != "PDFTable2CSV" || kind != "layouts" || version != 1)
+  {
+    std::cerr << "Unknown layout library format: " << fileName << std::endl;
+    return false;
+  }
+
+  std::vector<std::shared_ptr<const Layout>> layouts;
+  std::string tag;
+  while(file >> tag)
+  {
+    // layout <width> <height> <bands>, then per band: <top> <bottom> <n> <x1> ... <xn>
+    std::shared_ptr<Layout> layout(new Layout);
+    size_t bands = 0;
+    cv::Size &size = layout->pageSize;
+    if(tag != "layout" || !(file >> size.width >> size.height >> bands) || \
+       size.width <= 0 || size.height <= 0 || size.width > maxPageSide || size.height > maxPageSide || bands > maxBands)
+    {
+      std::cerr << "Broken layout library: " << fileName << std::endl;
+      return false;
+    }
+
+    layout->bands.resize(bands);
+    for(GridBand &band : layout->bands)
+    {
+      size_t count = 0;
+      file >> band.top >> band.bottom >> count;
+      if(!file || count < 2 || count > maxColumns || band.top < 0 || band.top >= band.bottom || band.bottom >= size.height)
+      {
+        std::cerr << "Broken layout library: " << fileName << std::endl;
+        return false;
+      }
+
+      // Lines go from left to right inside the page
+      band.xs.resize(count);
+      bool ordered = true;
+      for(size_t i = 0; i < count && file >> band.xs[i]; ++i)
+        ordered &= band.xs[i] >= 0 && band.xs[i] < size.width && (i == 0 || band.xs[i] > band.xs[i - 1]);
+      if(!file || !ordered)
+      {
+        std::cerr << "Broken layout library: " << fileName << std::endl;
+        return false;
+      }
+    }
+    layouts.push_back(layout);
+  }
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_layouts.insert(m_layouts.end(), layouts.begin(), layouts.end());
+  if(m_layouts.size() > static_cast<size_t>(settings::layoutCacheSize))
+    m_layouts.resize(settings::layoutCacheSize);
+  return true;
+}
+
+bool LayoutCache::Save(const std::string &fileName) const
+{
+  std::ofstream file(fileName);
+  if(!file.is_open())
+    return false;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  file << "PDFTable2CSV layouts 1\n";
+  for(const auto &layout : m_layouts)
+  {
+    file << "layout " << layout->pageSize.width << ' ' << layout->pageSize.height << ' ' << layout->bands.size() << '\n';
+    for(const GridBand &band : layout->bands)
+    {
+      file << band.top << ' ' << band.bottom << ' ' << band.xs.size();
+      for(int x : band.xs)
+        file << ' ' << x;
+      file << '\n';
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+void LayoutCache::Report(std::ostream &out) const
+{
+  size_t layouts = 0;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    layouts = m_layouts.size();
+  }
+  out << "Layout templates: " << layouts << ", hits: " << m_hits << ", misses: " << m_misses << std::endl;
+}
@@ -0,0 +1,66 @@
+#ifndef LAYOUTCACHE_H
+#define LAYOUTCACHE_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "tablegrid.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Process-wide library of table layouts.
+ * Filings are mostly a handful of printed forms, so the grid detected on
+ * one page is kept as a template. A later page is checked against the
+ * templates by sampling its thresholded image along the template lines and
+ * next to them: every line must be inked and the samples beside them mostly
+ * not, and no row outside the template lines may be a ruling of its own.
+ * On a hit the grid is rebuilt from the template and line detection is
+ * skipped. Templates live in memory and optionally in a text file.
+ */
+class LayoutCache
+{
+public:
+  static LayoutCache & Instance();
+
+  // Read templates from library file, false if it could not be read
+  bool Load(const std::string &fileName);
+  // Write all templates to library file
+  bool Save(const std::string &fileName) const;
+
+  // Rebuild grid of the first template that fits the thresholded page, false on miss
+  bool Match(const cv::Mat &binary, TableGrid &grid);
+
+  // Keep grid detected on page of given size, unless an equal template is known
+  void Store(const TableGrid &grid, const cv::Size &pageSize);
+
+  // Print hit / miss counters
+  void Report(std::ostream &out) const;
+
+private:
+  LayoutCache() = default;
+  LayoutCache(const LayoutCache &) = delete;
+  LayoutCache & operator=(const LayoutCache &) = delete;
+
+  struct Layout
+  {
+    cv::Size pageSize;
+    std::vector<GridBand> bands;
+  };
+
+  // Every template line is inked, samples beside lines mostly are not and
+  // there are no other long horizontal rulings on the page
+  static bool Fits(const cv::Mat &binary, const Layout &layout);
+  static bool Same(const Layout &a, const Layout &b);
+
+  mutable std::mutex m_lock;
+  std::vector<std::shared_ptr<const Layout>> m_layouts; // most recently hit first
+
+  std::atomic<long long> m_hits{0};
+  std::atomic<long long> m_misses{0};
+};
+
+#endif // LAYOUTCACHE_H
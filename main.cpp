@@ -1,88 +1,391 @@
 #include "segmentation.h"
 #include "imagefromfile.h"
+#include "imagefrommemory.h"
+#include "threadpool.h"
+#include "pagestream.h"
+#include "ocrenginepool.h"
+#include "ocrcache.h"
+#include "textnormalizer.h"
+#include "csvwriter.h"
+#include "cellstore.h"
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <cstdlib>
+#include <memory>
 
 /*Program for extracting structured text information from graphical documents that contains information about affilated persons
  * REQUIREMENTS:
  * OpenCV 3.2 - Image processing and pattern recognition
  * Tesseract - OCR API 3.05.00 - Recognize text from each cell
- * Ghostscript 9.21 API - split PDF file
- * CellCSV - write result in CSV file (https://github.com/d4nF/CellCSV)
+ * Ghostscript 9.21 API - render PDF pages into memory
+ * DenseTable - table of a page, CsvWriter - write it in CSV file on a background thread
 */
 
 /* Usage:
- * Path until source PDF file;
+ * [-j N] number of pages processed in parallel;
+ * [-c N] number of cells of one page recognized in parallel;
+ * [-q N] number of rendered pages waiting for segmentation;
+ * [-p F-L] range of pages to process, counting from 1;
+ * [-g] process pages in gray, stamp is searched on a small color thumbnail;
+ * [-o N] render pages N times bigger, detect grid on the working size and recognize cells from the big page;
+ * [-l file] library of table layouts, read before and written after the run;
+ * [-t file] cache of recognized cell texts, read before and written after the run;
+ * [-d D] delimiter of CSV fields, "tab" for tabulation;
+ * [-e crlf|lf] line ending of CSV files;
+ * [-m] also write all cells of the document into one columnar binary file <name>.cells;
+ * [-r] always detect table lines, layouts are only stored;
+ * [-n] do not use layout templates at all;
+ * [-b N] benchmark preprocessing of every page N times instead of recognition;
+ * [-s file] summary of documents: pages, cells, time and status, <dst>/summary.tsv in batch mode;
+ * Exit status is 2 if any document was not converted completely;
+ * Path until source PDF file, or a directory of them, a glob pattern or @file listing one per line;
  * Path until output csv's;
  * Recognition language
 */
 
-std::string settings::inPath;
-std::string settings::outPath;
-const char * settings::lang;
-
 int main(int argc, char* argv[])
 {
-  if (argc < 3)
+  Job job;
+  job.gray = settings::grayMode;
+  job.ocrScale = settings::ocrScale;
+  int jobs = settings::jobs;
+  int cellJobs = settings::cellJobs;
+  int queueDepth = settings::queueDepth;
+  int firstPage = 1, lastPage = 0; // lastPage 0 - until the end
+  int benchIterations = 0; // 0 - recognize pages, otherwise only time preprocessing
+  std::string layoutLibrary;
+  std::string ocrCacheFile;
+  std::string summaryFile;
+  bool columnar = false;
+  job.csvFormat.delimiter = settings::csvDelimiter;
+  job.csvFormat.lineEnd = settings::csvLineEnd;
+  std::vector<std::string> args;
+
+  for(int i = 1; i < argc; ++i)
   {
-    // Expect 4 arguments: the program name, path until source PDF file, path until output csv's, recognition language
-    std::cerr << "Usage: " << argv[0] << "<srcPDFfile> <outputCSVfile> [lang]"
+    const std::string arg = argv[i];
+    if(arg == "-j" && i + 1 < argc)
+      jobs = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "-c" && i + 1 < argc)
+      cellJobs = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "-q" && i + 1 < argc)
+      queueDepth = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "-g")
+      job.gray = true;
+    else if(arg == "-o" && i + 1 < argc)
+      job.ocrScale = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "-l" && i + 1 < argc)
+      layoutLibrary = argv[++i];
+    else if(arg == "-t" && i + 1 < argc)
+      ocrCacheFile = argv[++i];
+    else if(arg == "-d" && i + 1 < argc)
+    {
+      job.csvFormat.delimiter = argv[++i];
+      if(job.csvFormat.delimiter == "tab")
+        job.csvFormat.delimiter = "\t";
+    }
+    else if(arg == "-e" && i + 1 < argc)
+      job.csvFormat.lineEnd = std::string(argv[++i]) == "crlf" ? "\r\n" : "\n";
+    else if(arg == "-s" && i + 1 < argc)
+      summaryFile = argv[++i];
+    else if(arg == "-m")
+      columnar = true;
+    else if(arg == "-r")
+      job.redetect = true;
+    else if(arg == "-n")
+      job.layouts = false;
+    else if(arg == "-b" && i + 1 < argc)
+      benchIterations = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "-p" && i + 1 < argc)
+    {
+      // "F-L", "F-" or single page "F"
+      const std::string range = argv[++i];
+      const size_t dash = range.find('-');
+      firstPage = std::max(1, std::atoi(range.substr(0, dash).c_str()));
+      if(dash == std::string::npos)
+        lastPage = firstPage;
+      else
+        lastPage = std::atoi(range.substr(dash + 1).c_str());
+    }
+    else
+      args.push_back(arg);
+  }
+
+  if (args.size() < 2)
+  {
+    // Expect source PDF file or batch of them, output csv's path and optional recognition language
+    std::cerr << "Usage: " << argv[0] << " [-j N] [-c N] [-q N] [-p F-L] [-b N] [-g] [-o N] [-l file] [-t file] [-d D] [-e crlf|lf] [-m] [-r] [-n] [-s file] <srcPDFfile|dir|glob|@list> <outputCSVfile> [lang]"
               << std::endl;
     return 1;
   }
-  else
-  {
-    for(int i = 1; i < argc; ++i)
-    {
-      settings::inPath = argv[i++]; // src
-      settings::outPath = argv[i++]; // dst
 
-      if(argc == 4)
-        settings::lang = argv[i++]; // lang
-      else
-        settings::lang = "rus";
-        break;
+  const std::string source = args[0]; // src
+  job.outPath = args[1]; // dst
+  if(args.size() > 2)
+    job.lang = args[2]; // lang
 
-    }
+  const std::vector<std::string> documents = ListDocuments(source);
+  if(summaryFile.empty() && IsBatchSource(source))
+    summaryFile = job.outPath + "/summary.tsv";
+
+  std::cout<<"src: " <<source<<"\n" \
+           <<"documents: "<<documents.size()<<"\n"
+           <<"dst: " <<job.outPath<<"\n"
+           <<"lang: "<<job.lang<<"\n"
+           <<"jobs: "<<jobs<<"\n"
+           <<"cell jobs: "<<cellJobs<<"\n"
+           <<"queue depth: "<<queueDepth<<"\n"
+           <<"gray: "<<(job.gray ? "yes" : "no")<<"\n"
+           <<"OCR scale: "<<job.ocrScale<<"\n"
+           <<"layouts: "<<(!job.layouts ? "off" : layoutLibrary.empty() ? "memory" : layoutLibrary)<<(job.redetect ? ", redetect" : "")<<std::endl;
+
+  if(documents.empty())
+  {
+    std::cerr << RED << "Fail! No PDF files in " << source << "\n" << RESET;
+    return 1;
   }
 
-  std::cout<<"src: " <<settings::inPath<<"\n" \
-           <<"dst: " <<settings::outPath<<"\n"
-           <<"lang: "<<settings::lang<<std::endl;
+  // Documents with the same file name in different folders must not overwrite each other's output
+  const std::vector<std::string> outNames = OutputNames(documents);
+  for(size_t d = 0; d < documents.size(); ++d)
+  {
+    if(outNames[d] != Converter::GetFilename(documents[d]))
+      std::cout << YELLOW << "Output of " << documents[d] << " is named " << outNames[d] << RESET << std::endl;
+  }
+
+  // A missing library or cache is created at the end of the run
+  if(!layoutLibrary.empty())
+    LayoutCache::Instance().Load(layoutLibrary);
 
-  // Array with paths until png pages
-  std::vector<std::string> pagesVec;
+  std::vector<DocumentResult> results;
+  bool aborted = false; // batch stopped before its end
 
   try
   {
-    // Initialize converter
-    Converter * initConv = new Converter(settings::inPath, settings::outPath, settings::dpi); // in:argv[1], out:argv[2]
+    // Cells of every page are shared by one pool, independent from page workers
+    std::unique_ptr<ThreadPool> cellPool;
+    if(cellJobs > 1)
+    {
+      cellPool.reset(new ThreadPool(cellJobs));
+      job.cellPool = cellPool.get();
+    }
+
+    // Pages of all documents are spread over one pool, every worker keeps its buffers from page to page
+    std::unique_ptr<ThreadPool> pagePool;
+    if(jobs > 1)
+      pagePool.reset(new ThreadPool(jobs));
+    std::vector<PageWorkspace> workspaces(jobs);
+
+    // Text filters are built once and shared by every cell
+    TextNormalizer normalizer;
+    job.normalizer = &normalizer;
 
-    // Split PDF file on pages
-    initConv->ToPNG();
-    pagesVec = initConv->ListPages();
+    // Pages hand their tables over and go on with the next one
+    CsvWriter csvWriter(job.csvFormat, settings::csvQueueDepth);
+    job.csvWriter = &csvWriter;
 
-    // Processing every page
-    for(auto p:pagesVec)
+    // One initialized engine per recognizing worker, checked out for every page or cell;
+    // engines, caches and the Ghostscript instance stay warm from document to document
+    const int engines = job.cellPool ? cellJobs : jobs;
+    OcrEnginePool::Instance().SetCapacity(engines);
+    OcrEnginePool::Instance().Prewarm(job.lang, engines);
+
+    // Cached texts are valid only for the engine and traineddata that recognized them
+    OcrCache::Instance().SetEngine(OcrEnginePool::Instance().Identity(job.lang));
+    if(!ocrCacheFile.empty())
+      OcrCache::Instance().Load(ocrCacheFile);
+
+    // A failed document is reported in the summary, the rest of the batch goes on
+    auto convertDocument = [&](DocumentResult &result)
     {
-      Segmentation * page = new ImageFromFile(p);
-      page->preProcess();
+      std::atomic<long long> cells(0);
+      job.inPath = result.path;
+      job.outName = result.outName;
+      job.cellCount = &cells;
+
+      CellStore cellStore;
+      job.cellStore = columnar ? &cellStore : nullptr;
+
+      try
+      {
+        // Initialize converter
+        std::unique_ptr<Converter> initConv(new Converter(job.inPath, settings::dpi * job.ocrScale));
+        initConv->SetRenderScale(job.ocrScale);
+        initConv->SetPageRange(firstPage - 1, lastPage - 1);
+
+        // Total is known from the PDF structure before rendering starts
+        int total = initConv->PageCount();
+        if(total > 0)
+        {
+          const int last = lastPage > 0 ? std::min(lastPage, total) : total;
+          total = std::max(0, last - firstPage + 1);
+        }
+
+        int pageCount = 0;
+        std::atomic<int> processed(0);
+        std::atomic<int> failed(0);
+        {
+          // Split PDF file on pages in background, every page is processed as soon as it is rendered
+          PageStream stream(*initConv, queueDepth);
+
+          auto processPage = [&](const RenderedPage &rendered, PageWorkspace &workspace)
+          {
+            // A broken page does not stop the others
+            try
+            {
+              ImageFromMemory page(rendered.image, job, rendered.pageNum, workspace);
+              // Benchmarked page counts as processed, it is only not recognized
+              if(benchIterations > 0)
+                page.BenchPreProcess(benchIterations);
+              else
+                page.preProcess();
+            }
+            catch(std::exception const &ex)
+            {
+              ++failed;
+              std::cerr << RED << "Caught exception while processing page " << rendered.pageNum << ": " << ex.what() << RESET << std::endl;
+              return;
+            }
+
+            const int done = ++processed;
+            if(total > 0)
+              std::cout << "Page " << done << " of " << total << std::endl;
+            else
+              std::cout << "Page " << done << std::endl;
+          };
+
+          RenderedPage rendered;
+          if(!pagePool)
+          {
+            while(stream.Next(rendered))
+              processPage(rendered, workspaces[0]);
+          }
+          else
+          {
+            // Every page is a task of its own, an idle worker steals pages queued for a busy one.
+            // Pages handed to the pool are bounded, as the rendered ones waiting in the stream
+            std::mutex inFlightLock;
+            std::condition_variable pageDone;
+            int inFlight = 0;
+
+            TaskGroup pages(*pagePool);
+            while(stream.Next(rendered))
+            {
+              {
+                std::unique_lock<std::mutex> guard(inFlightLock);
+                pageDone.wait(guard, [&]{ return inFlight < jobs + queueDepth; });
+                ++inFlight;
+              }
+              pages.Submit([&, rendered](int worker)
+              {
+                processPage(rendered, workspaces[worker]);
+                {
+                  std::lock_guard<std::mutex> guard(inFlightLock);
+                  --inFlight;
+                }
+                pageDone.notify_one();
+              });
+            }
+            pages.Wait();
+          }
+
+          pageCount = stream.Rendered();
+        }
+
+        result.pages = processed;
+        if(pageCount == 0)
+        {
+          std::cerr << RED << "Fail! PDF file does not contain pages! \n" << RESET;
+          result.status = "no pages";
+        }
+        else if(failed > 0)
+        {
+          result.status = "failed pages: " + std::to_string(failed);
+        }
+
+        // Close the document, Ghostscript itself is kept for the next one
+        initConv.reset();
+
+        if(columnar && benchIterations == 0)
+        {
+          const std::string cellsName = job.outPath + "/" + job.outName + ".cells";
+          if(cellStore.Save(cellsName))
+            std::cout << "Cells: " << cellStore.Size() << " written to " << cellsName << std::endl;
+          else
+            std::cerr << RED << "Can't write " << cellsName << "\n" << RESET;
+        }
+      }
+      catch(std::exception const &ex)
+      {
+        std::cerr << ex.what();
+        result.status = std::string("error: ") + ex.what();
+      }
+
+      job.cellStore = nullptr;
+      job.cellCount = nullptr;
+      result.cells = cells;
+    };
+
+    for(size_t d = 0; d < documents.size(); ++d)
+    {
+      if(documents.size() > 1)
+        std::cout << "Document " << d + 1 << " of " << documents.size() << ": " << documents[d] << std::endl;
+
+      DocumentResult result;
+      result.path = documents[d];
+      result.outName = outNames[d];
+      const auto start = std::chrono::steady_clock::now();
+      convertDocument(result);
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      results.push_back(result);
     }
 
-    // Delete png files(pages) and clean memory
-    delete initConv;
+    csvWriter.Close();
+    job.csvWriter = nullptr;
+
+    OcrEnginePool::Instance().Report(std::cout);
+    PageWorkspace::Report(std::cout);
+    csvWriter.Report(std::cout);
+    LayoutCache::Instance().Report(std::cout);
+
+    if(!layoutLibrary.empty() && !LayoutCache::Instance().Save(layoutLibrary))
+      std::cerr << RED << "Can't write layout library " << layoutLibrary << "\n" << RESET;
+
+    OcrCache::Instance().Report(std::cout);
+    if(!ocrCacheFile.empty() && !OcrCache::Instance().Save(ocrCacheFile))
+      std::cerr << RED << "Can't write OCR cache " << ocrCacheFile << "\n" << RESET;
 
   }
 
   catch(std::exception const &ex)
   {
     std::cerr << ex.what();
+    aborted = true;
+  }
+
+  const long long failedDocuments = std::count_if(results.begin(), results.end(),
+                                                  [](const DocumentResult &r) { return r.status != "ok"; });
+  if(!summaryFile.empty())
+  {
+    if(WriteSummary(summaryFile, results))
+      std::cout << "Documents: " << results.size() << ", not ok: " << failedDocuments << ", summary: " << summaryFile << std::endl;
+    else
+      std::cerr << RED << "Can't write summary " << summaryFile << "\n" << RESET;
   }
 
 
   /* For a single page
-  Segmentation * a = new ImageFromFile("/Users/V3r0n/Downloads/page_2.png");
-  a->preProcess();
+  Job single;
+  PageWorkspace workspace;
+  ImageFromFile a("/Users/V3r0n/Downloads/page_2.png", single, 0, workspace);
+  a.preProcess();
   */
 
-  return 0;
+  // Scripts see a partly failed batch
+  return (aborted || failedDocuments > 0) ? 2 : 0;
 }
-
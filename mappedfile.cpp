@@ -0,0 +1,62 @@
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &fileName)
+{
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  if(fd < 0)
+    return;
+
+  struct stat st;
+  if(fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr != MAP_FAILED)
+    {
+      m_data = static_cast<const char *>(addr);
+      m_size = st.st_size;
+    }
+  }
+
+  close(fd); // mapping stays valid
+}
+
+MappedFile::~MappedFile()
+{
+  if(m_data)
+    munmap(const_cast<char *>(m_data), m_size);
+}
+
+size_t MappedFile::Find(const char * needle, size_t pos, size_t count) const
+{
+  const size_t len = std::strlen(needle);
+  if(!m_data || pos >= m_size || len > m_size - pos)
+    return std::string::npos;
+
+  const size_t haystack = std::min(count, m_size - pos);
+  const void * found = memmem(m_data + pos, haystack, needle, len);
+  return found ? static_cast<const char *>(found) - m_data : std::string::npos;
+}
+
+size_t MappedFile::RFind(const char * needle, size_t pos) const
+{
+  const size_t len = std::strlen(needle);
+  if(!m_data || len > m_size)
+    return std::string::npos;
+
+  size_t i = std::min(pos, m_size - len);
+  for(;;)
+  {
+    if(std::memcmp(m_data + i, needle, len) == 0)
+      return i;
+    if(i == 0)
+      return std::string::npos;
+    --i;
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string &fileName);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  bool IsOpen() const { return m_data != nullptr; }
+
+  const char * Data() const { return m_data; }
+  size_t Size() const { return m_size; }
+
+  char operator[](size_t pos) const { return m_data[pos]; }
+
+  // Position of needle within count bytes from pos, std::string::npos if missing
+  size_t Find(const char * needle, size_t pos = 0, size_t count = std::string::npos) const;
+
+  // Position of last needle starting at or before pos
+  size_t RFind(const char * needle, size_t pos = std::string::npos) const;
+
+private:
+  const char * m_data = nullptr;
+  size_t m_size = 0;
+};
+
+#endif // MAPPEDFILE_H
@@ -1,26 +1,52 @@
 #include "ocr.h"
+#include "ocrenginepool.h"
+#include "settings.h"
 #include "wchar.h"
 #include "locale.h"
 
-OCR::OCR()
+#include <chrono>
+
+OCR::OCR(const std::string &lang):
+  m_lang(lang)
+{
+  m_tesserApi = OcrEnginePool::Instance().Acquire(m_lang);
+}
+
+OCR::~OCR()
 {
-  m_tesserApi = new tesseract::TessBaseAPI();
-  if (m_tesserApi->Init(nullptr, lang)) {
-         std::cerr << "Could not initialize tesseract.\n" << std::endl;
-         exit(1);
-     }
+  OcrEnginePool::Instance().Release(m_lang, m_tesserApi);
 }
 
-std::wstring OCR::extractText(const cv::Mat &srcPic)
+std::string OCR::extractText(const cv::Mat &srcPic, CellType type)
 {
   char * outText;
 
+  // Engines are shared, restricted configuration is reverted after the cell
+  const PageSegMode mode = m_tesserApi->GetPageSegMode();
+  if(type != TextCell)
+  {
+    m_tesserApi->SetPageSegMode(PSM_SINGLE_LINE);
+    m_tesserApi->SetVariable("tessedit_char_whitelist", type == DateCell ? settings::dateChars : settings::numberChars);
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+
   m_tesserApi->SetImage((uchar*)srcPic.data, srcPic.size().width, srcPic.size().height, srcPic.channels(), srcPic.step);
   m_tesserApi->Recognize(0);
 
+  if(type != TextCell)
+  {
+    m_tesserApi->SetPageSegMode(mode);
+    m_tesserApi->SetVariable("tessedit_char_whitelist", "");
+  }
+
+  OcrEnginePool::Instance().AddRecognizeTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+
   outText = m_tesserApi->GetUTF8Text();
+  m_confidence = m_tesserApi->MeanTextConf();
 
-  // Convert UTF-8 to Unicode
-  std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> UTF8_UTF_16_CONVERTER;
-  return UTF8_UTF_16_CONVERTER.from_bytes(outText);
+  // Buffer of Tesseract is allocated by new[]
+  std::string text = outText ? outText : "";
+  delete [] outText;
+  return text;
 }
@@ -1,24 +1,37 @@
 #ifndef OCR_H
 #define OCR_H
 
-#include "segmentation.h"
+#include "opencv2/imgproc/imgproc.hpp"
 #include <tesseract/baseapi.h>
 
+#include <string>
+
 using namespace tesseract;
+
+// Content of a table column, restricted types are recognized with a whitelist as a single line
+enum CellType {TextCell, NumberCell, DateCell};
+
+// Engine checked out of OcrEnginePool for the lifetime of the object
 class OCR
 {
 public:
-  OCR();
-  ~OCR()
-  {
-    m_tesserApi->End();
-  }
+  OCR(const std::string &lang);
+  ~OCR();
+
+  OCR(const OCR &) = delete;
+  OCR & operator=(const OCR &) = delete;
+
+  // Recognized text in UTF-8
+  std::string extractText(const cv::Mat &srcPic, CellType type = TextCell);
 
-  std::wstring extractText(const cv::Mat &srcPic);
+  // Mean confidence of the last extracted text, 0..100
+  int Confidence() const { return m_confidence; }
 
 private:
 
+  const std::string m_lang;
   TessBaseAPI * m_tesserApi = nullptr;
+  int m_confidence = 0;
 
 };
 
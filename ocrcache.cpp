@@ -0,0 +1,218 @@
+#include "ocrcache.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  // FNV-1a, 64 bit
+  const uint64_t fnvOffset = 14695981039346656037ULL;
+  const uint64_t fnvPrime = 1099511628211ULL;
+
+  uint64_t Fnv(uint64_t hash, const uchar * data, size_t size)
+  {
+    for(size_t i = 0; i < size; ++i)
+    {
+      hash ^= data[i];
+      hash *= fnvPrime;
+    }
+    return hash;
+  }
+
+  // Texts are kept one per line, line breaks and backslashes are escaped
+  std::string Escape(const std::string &text)
+  {
+    std::string result;
+    for(char c : text)
+    {
+      if(c == '\\') result += "\\\\";
+      else if(c == '\n') result += "\\n";
+      else if(c == '\r') result += "\\r";
+      else result.push_back(c);
+    }
+    return result;
+  }
+
+  std::string Unescape(const std::string &text)
+  {
+    std::string result;
+    for(size_t i = 0; i < text.size(); ++i)
+    {
+      if(text[i] == '\\' && i + 1 < text.size())
+      {
+        const char c = text[++i];
+        result.push_back(c == 'n' ? '\n' : c == 'r' ? '\r' : c);
+      }
+      else
+        result.push_back(text[i]);
+    }
+    return result;
+  }
+}
+
+OcrCache & OcrCache::Instance()
+{
+  static OcrCache cache;
+  return cache;
+}
+
+uint64_t OcrCache::Key(const cv::Mat &cellImage, const std::string &config)
+{
+  cv::Mat gray, binary;
+  if(cellImage.channels() == 3)
+    cv::cvtColor(cellImage, gray, cv::COLOR_BGR2GRAY);
+  else
+    gray = cellImage;
+
+  // Ink is 255 whatever the background level is
+  cv::threshold(gray, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+
+  std::vector<cv::Point> ink;
+  cv::findNonZero(binary, ink);
+  const cv::Rect trim = ink.empty() ? cv::Rect() : cv::boundingRect(ink);
+
+  uint64_t hash = Fnv(fnvOffset, reinterpret_cast<const uchar *>(config.data()), config.size());
+  const int size[2] = {trim.width, trim.height};
+  hash = Fnv(hash, reinterpret_cast<const uchar *>(size), sizeof(size));
+  for(int y = trim.y; y < trim.y + trim.height; ++y)
+    hash = Fnv(hash, binary.ptr<uchar>(y) + trim.x, trim.width);
+  return hash;
+}
+
+bool OcrCache::Find(uint64_t key, std::string &text, int &confidence)
+{
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_texts.find(key);
+    if(it != m_texts.end())
+    {
+      text = it->second.text;
+      confidence = it->second.confidence;
+      ++m_hits;
+      return true;
+    }
+
+    // Entry of the older generation is used again, it moves to the current one
+    it = m_older.find(key);
+    if(it != m_older.end())
+    {
+      text = it->second.text;
+      confidence = it->second.confidence;
+      Entry entry = std::move(it->second);
+      m_older.erase(it);
+      Insert(key, std::move(entry));
+      ++m_hits;
+      return true;
+    }
+  }
+  ++m_misses;
+  return false;
+}
+
+void OcrCache::Store(uint64_t key, const std::string &text, int confidence)
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  Insert(key, Entry{text, confidence});
+}
+
+void OcrCache::Insert(uint64_t key, Entry entry)
+{
+  // Full current generation becomes the older one, entries not used since then are dropped
+  const size_t generation = std::max(1, settings::ocrCacheSize / 2);
+  if(m_texts.size() >= generation && !m_texts.count(key))
+  {
+    m_evicted += m_older.size();
+    m_older.swap(m_texts);
+    m_texts.clear();
+  }
+  m_texts[key] = std::move(entry);
+}
+
+bool OcrCache::Load(const std::string &fileName)
+{
+  std::ifstream file(fileName);
+  if(!file.is_open())
+    return false;
+
+  std::string line;
+  if(!std::getline(file, line) || line != "PDFTable2CSV ocr 3")
+  {
+    std::cerr << "Unknown OCR cache format, not used: " << fileName << std::endl;
+    return false;
+  }
+
+  // Texts of another Tesseract or traineddata may differ
+  if(!std::getline(file, line) || line != "engine " + m_engine)
+  {
+    std::cerr << "OCR cache of another engine, not used: " << fileName << std::endl;
+    return false;
+  }
+
+  // <16 hex digits of key> <confidence> <escaped text>
+  std::lock_guard<std::mutex> guard(m_lock);
+  while(std::getline(file, line))
+  {
+    size_t keyEnd = 0, confEnd = 0;
+    size_t textBegin = 17;
+    uint64_t key = 0;
+    int confidence = -1;
+    try
+    {
+      key = std::stoull(line.substr(0, 16), &keyEnd, 16);
+      confidence = std::stoi(line.substr(17), &confEnd);
+      textBegin += confEnd + 1;
+    }
+    catch(std::exception const &)
+    {
+    }
+    if(line.size() < textBegin || line[16] != ' ' || keyEnd != 16 || !confEnd || line[textBegin - 1] != ' ')
+    {
+      std::cerr << "Broken OCR cache: " << fileName << std::endl;
+      return false;
+    }
+    Insert(key, Entry{Unescape(line.substr(textBegin)), confidence});
+  }
+  return true;
+}
+
+bool OcrCache::Save(const std::string &fileName) const
+{
+  std::ofstream file(fileName);
+  if(!file.is_open())
+    return false;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  file << "PDFTable2CSV ocr 3\n";
+  file << "engine " << m_engine << '\n';
+  // Older generation first, so the current one is current again after Load
+  for(const auto *texts : {&m_older, &m_texts})
+  {
+    for(const auto &entry : *texts)
+    {
+      file << std::hex << std::setw(16) << std::setfill('0') << entry.first << ' ' \
+           << std::dec << entry.second.confidence << ' ' << Escape(entry.second.text) << '\n';
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+void OcrCache::Report(std::ostream &out) const
+{
+  size_t texts = 0;
+  long long evicted = 0;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    texts = m_texts.size() + m_older.size();
+    evicted = m_evicted;
+  }
+  const long long hits = m_hits, misses = m_misses;
+  std::ostringstream rate;
+  if(hits + misses > 0)
+    rate << " (" << std::fixed << std::setprecision(1) << 100.0 * hits / (hits + misses) << "% hit rate)";
+  out << "OCR cache: " << texts << " texts, hits: " << hits << ", misses: " << misses << rate.str() \
+      << ", evicted: " << evicted << std::endl;
+}
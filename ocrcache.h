@@ -0,0 +1,71 @@
+#ifndef OCRCACHE_H
+#define OCRCACHE_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/* Process-wide cache of recognized cell texts.
+ * Headers, fixed labels and short answers repeat on every page of a form,
+ * so the text is looked up by the content of the cell: its bitmap is
+ * binarized by Otsu, trimmed to the ink and hashed together with the
+ * recognition config. A position shift or another background level gives
+ * the same key. Entries live in memory and optionally in a text file, which
+ * is not used when it was made by another engine or traineddata.
+ */
+class OcrCache
+{
+public:
+  static OcrCache & Instance();
+
+  // Hash of binarized and trimmed cell bitmap and recognition config
+  static uint64_t Key(const cv::Mat &cellImage, const std::string &config);
+
+  // Text and mean confidence recognized earlier for the key, false on miss
+  bool Find(uint64_t key, std::string &text, int &confidence);
+  void Store(uint64_t key, const std::string &text, int confidence);
+
+  // Engine that recognizes the texts, see OcrEnginePool::Identity; set before Load
+  void SetEngine(const std::string &identity) { m_engine = identity; }
+
+  // Read entries from file, false if it could not be read or is of another engine
+  bool Load(const std::string &fileName);
+  // Write all entries to file
+  bool Save(const std::string &fileName) const;
+
+  // Print hit / miss counters
+  void Report(std::ostream &out) const;
+
+private:
+  OcrCache() = default;
+  OcrCache(const OcrCache &) = delete;
+  OcrCache & operator=(const OcrCache &) = delete;
+
+  struct Entry
+  {
+    std::string text;
+    int confidence;
+  };
+
+  std::string m_engine;
+
+  // Put entry into the current generation, under m_lock
+  void Insert(uint64_t key, Entry entry);
+
+  mutable std::mutex m_lock;
+  // Two generations of at most ocrCacheSize / 2 entries: when the current one is full it
+  // replaces the older one, whose entries not used meanwhile are dropped
+  std::unordered_map<uint64_t, Entry> m_texts;
+  std::unordered_map<uint64_t, Entry> m_older;
+
+  std::atomic<long long> m_hits{0};
+  std::atomic<long long> m_misses{0};
+  long long m_evicted = 0; // under m_lock
+};
+
+#endif // OCRCACHE_H
@@ -0,0 +1,143 @@
+#include "ocrenginepool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+OcrEnginePool & OcrEnginePool::Instance()
+{
+  static OcrEnginePool pool;
+  return pool;
+}
+
+OcrEnginePool::~OcrEnginePool()
+{
+  for(auto &lang:m_engines)
+  {
+    for(auto engine:lang.second.all)
+    {
+      engine->End();
+      delete engine;
+    }
+  }
+}
+
+void OcrEnginePool::SetCapacity(int capacity)
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_capacity = std::max(1, capacity);
+}
+
+void OcrEnginePool::Prewarm(const std::string &lang, int count)
+{
+  std::vector<tesseract::TessBaseAPI *> engines;
+  for(int i = 0; i < count; ++i)
+    engines.push_back(Acquire(lang));
+  for(auto engine:engines)
+    Release(lang, engine);
+}
+
+std::string OcrEnginePool::Identity(const std::string &lang)
+{
+  tesseract::TessBaseAPI * engine = Acquire(lang);
+  std::string dataPath = engine->GetDatapath() ? engine->GetDatapath() : "";
+  Release(lang, engine);
+
+  if(!dataPath.empty() && dataPath.back() != '/')
+    dataPath += '/';
+
+  std::ostringstream identity;
+  identity << tesseract::TessBaseAPI::Version() << ' ' << dataPath;
+
+  // Languages are joined by '+', every one has its own file
+  std::istringstream langs(lang);
+  std::string name;
+  while(std::getline(langs, name, '+'))
+  {
+    struct stat info;
+    const std::string file = dataPath + name + ".traineddata";
+    identity << ' ' << name << '@' << (stat(file.c_str(), &info) == 0 ? static_cast<long long>(info.st_mtime) : 0);
+  }
+  return identity.str();
+}
+
+tesseract::TessBaseAPI * OcrEnginePool::CreateEngine(const std::string &lang)
+{
+  const auto begin = std::chrono::steady_clock::now();
+
+  tesseract::TessBaseAPI * engine = new tesseract::TessBaseAPI();
+  if (engine->Init(nullptr, lang.c_str()))
+  {
+    delete engine;
+    throw std::runtime_error("Could not initialize tesseract for language " + lang);
+  }
+
+  m_initNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+  ++m_initCount;
+
+  return engine;
+}
+
+tesseract::TessBaseAPI * OcrEnginePool::Acquire(const std::string &lang)
+{
+  std::unique_lock<std::mutex> guard(m_lock);
+  Engines &engines = m_engines[lang];
+
+  m_released.wait(guard, [&]
+  {
+    return !engines.idle.empty() || static_cast<int>(engines.all.size()) + engines.creating < m_capacity;
+  });
+
+  if(!engines.idle.empty())
+  {
+    tesseract::TessBaseAPI * engine = engines.idle.back();
+    engines.idle.pop_back();
+    return engine;
+  }
+
+  // Init takes seconds, don't hold the lock meanwhile
+  ++engines.creating;
+  guard.unlock();
+
+  tesseract::TessBaseAPI * engine = nullptr;
+  try
+  {
+    engine = CreateEngine(lang);
+  }
+  catch(...)
+  {
+    guard.lock();
+    --engines.creating;
+    m_released.notify_one();
+    throw;
+  }
+
+  guard.lock();
+  --engines.creating;
+  engines.all.push_back(engine);
+  return engine;
+}
+
+void OcrEnginePool::Release(const std::string &lang, tesseract::TessBaseAPI * engine)
+{
+  engine->Clear();
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_engines[lang].idle.push_back(engine);
+  }
+  m_released.notify_one();
+}
+
+void OcrEnginePool::Report(std::ostream &out) const
+{
+  const double initMs = m_initNs / 1e6;
+  const double recognizeMs = m_recognizeNs / 1e6;
+
+  out << "OCR engines initialized: " << m_initCount << ", init time: " << initMs << " ms\n"
+      << "OCR recognitions: " << m_recognizeCount << ", recognize time: " << recognizeMs << " ms";
+  if(m_recognizeCount > 0)
+    out << " (" << recognizeMs / m_recognizeCount << " ms per call)";
+  out << std::endl;
+}
@@ -0,0 +1,73 @@
+#ifndef OCRENGINEPOOL_H
+#define OCRENGINEPOOL_H
+
+#include <tesseract/baseapi.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Process-wide pool of initialized Tesseract engines.
+ * TessBaseAPI::Init loads the language traineddata, which costs more than
+ * recognizing a sparse page, so engines are created once per language and
+ * then checked out and back in. Clear() is run on every check in.
+ */
+class OcrEnginePool
+{
+public:
+  static OcrEnginePool & Instance();
+
+  ~OcrEnginePool();
+
+  // Maximum engines per language, Acquire blocks when all are checked out
+  void SetCapacity(int capacity);
+
+  // Initialize engines for language up front
+  void Prewarm(const std::string &lang, int count);
+
+  // Tesseract version, data path and modification times of the traineddata of language
+  std::string Identity(const std::string &lang);
+
+  tesseract::TessBaseAPI * Acquire(const std::string &lang);
+  void Release(const std::string &lang, tesseract::TessBaseAPI * engine);
+
+  // Account time spent in TessBaseAPI::Recognize
+  void AddRecognizeTime(long long ns)
+  {
+    m_recognizeNs += ns;
+    ++m_recognizeCount;
+  }
+
+  // Print init / recognize counters
+  void Report(std::ostream &out) const;
+
+private:
+  OcrEnginePool() = default;
+  OcrEnginePool(const OcrEnginePool &) = delete;
+  OcrEnginePool & operator=(const OcrEnginePool &) = delete;
+
+  struct Engines
+  {
+    std::vector<tesseract::TessBaseAPI *> all;
+    std::vector<tesseract::TessBaseAPI *> idle;
+    int creating = 0; // engines being initialized outside the lock
+  };
+
+  tesseract::TessBaseAPI * CreateEngine(const std::string &lang);
+
+  std::mutex m_lock;
+  std::condition_variable m_released;
+  std::map<std::string, Engines> m_engines;
+  int m_capacity = 1;
+
+  std::atomic<long long> m_initNs{0};
+  std::atomic<long long> m_initCount{0};
+  std::atomic<long long> m_recognizeNs{0};
+  std::atomic<long long> m_recognizeCount{0};
+};
+
+#endif // OCRENGINEPOOL_H
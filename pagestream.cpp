@@ -0,0 +1,36 @@
+#include "pagestream.h"
+
+PageStream::PageStream(Converter &converter, size_t depth):
+  m_converter(converter), m_queue(depth)
+{
+  m_producer = std::thread(&PageStream::Produce, this);
+}
+
+PageStream::~PageStream()
+{
+  m_queue.Close(); // unblock producer if consumers stopped early
+  m_producer.join();
+}
+
+void PageStream::Produce()
+{
+  try
+  {
+    m_converter.Render([this](int pageNum, const cv::Mat &image)
+    {
+      // Display device reuses its buffer for the next page
+      RenderedPage page;
+      page.pageNum = pageNum;
+      page.image = image.clone();
+
+      if(m_queue.Push(std::move(page)))
+        ++m_rendered;
+    });
+  }
+  catch(std::exception const &ex)
+  {
+    std::cerr << RED << "Caught exception while rendering: " << ex.what() << RESET << std::endl;
+  }
+
+  m_queue.Close();
+}
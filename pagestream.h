@@ -0,0 +1,49 @@
+#ifndef PAGESTREAM_H
+#define PAGESTREAM_H
+
+#include "converter.h"
+#include "boundedqueue.h"
+
+#include <atomic>
+#include <thread>
+
+// Page rendered by Ghostscript and owned by the consumer
+struct RenderedPage
+{
+  int pageNum = 0;
+  cv::Mat image;
+};
+
+/* Renders pages of a document on a background thread.
+ * Segmentation consumes page N while page N+1 is being rendered. At most
+ * depth pages wait in the queue, then rendering pauses until a consumer
+ * takes one.
+ */
+class PageStream
+{
+public:
+  PageStream(Converter &converter, size_t depth);
+  ~PageStream();
+
+  PageStream(const PageStream &) = delete;
+  PageStream & operator=(const PageStream &) = delete;
+
+  // Blocks until next page is rendered, false after the last page
+  bool Next(RenderedPage &page)
+  {
+    return m_queue.Pop(page);
+  }
+
+  // Number of pages rendered so far
+  int Rendered() const { return m_rendered; }
+
+private:
+  Converter &m_converter;
+  BoundedQueue<RenderedPage> m_queue;
+  std::thread m_producer;
+  std::atomic<int> m_rendered{0};
+
+  void Produce();
+};
+
+#endif // PAGESTREAM_H
@@ -0,0 +1,45 @@
+#include "pageworkspace.h"
+
+#include <algorithm>
+
+std::atomic<long long> PageWorkspace::m_pages{0};
+std::atomic<long long> PageWorkspace::m_allocations{0};
+std::atomic<long long> PageWorkspace::m_steadyAllocations{0};
+
+std::vector<const cv::Mat *> PageWorkspace::Buffers() const
+{
+  return {&grayPage, &resized, &thumbnail, &sharpness, &gray, &preprocess.contrast, &preprocess.blurred, &preprocess.graySharp, \
+          &horLines, &verLines, &blob, &blobScratch.dilated, &blobScratch.labels, \
+          &hsv, &stampMask, &stampBlob, &stampScratch.dilated, &stampScratch.labels, &stampPage, \
+          &warpColor, &warpGray, &warpSource, &projection.ColumnSums(), &ink, &inkSum};
+}
+
+void PageWorkspace::BeginPage()
+{
+  m_pageBuffers.clear();
+  for(const cv::Mat * buffer : Buffers())
+    m_pageBuffers.push_back(buffer->data);
+}
+
+void PageWorkspace::EndPage()
+{
+  // A buffer whose data is not among the buffers of page start was allocated during the page
+  long long allocated = 0;
+  for(const cv::Mat * buffer : Buffers())
+  {
+    if(buffer->data && std::find(m_pageBuffers.begin(), m_pageBuffers.end(), buffer->data) == m_pageBuffers.end())
+      ++allocated;
+  }
+
+  ++m_pages;
+  m_allocations += allocated;
+  if(m_warm)
+    m_steadyAllocations += allocated;
+  m_warm = true;
+}
+
+void PageWorkspace::Report(std::ostream &out)
+{
+  out << "Page image buffers allocated: " << m_allocations << " for " << m_pages << " pages, " \
+      << m_steadyAllocations << " after the first page of a worker" << std::endl;
+}
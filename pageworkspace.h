@@ -0,0 +1,80 @@
+#ifndef PAGEWORKSPACE_H
+#define PAGEWORKSPACE_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "preprocess.h"
+#include "projection.h"
+#include "tablegrid.h"
+
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+// Buffers of one biggest blob search
+struct BlobBuffers
+{
+  cv::Mat dilated;
+  cv::Mat labels; // connected components, 32 bit
+  cv::Mat stats;
+  cv::Mat centroids;
+};
+
+/* Full-size buffers of one page worker.
+ * Pages are resized to the fixed settings::width x height geometry, so
+ * every stage writes into buffers that keep their size from page to page
+ * and are allocated only for the first one. Not shared between threads,
+ * every worker owns its workspace.
+ */
+struct PageWorkspace
+{
+  cv::Mat grayPage; // gray mode: page converted at source resolution
+  cv::Mat resized; // page after resize, the cropped page is a view of it
+  cv::Mat thumbnail; // gray mode: downscaled color page for stamp detection
+  cv::Mat sharpness; // page after contrast and sharpness, gray in gray mode
+  cv::Mat gray; // blurred and thresholded grayscale
+  preprocess::Buffers preprocess;
+
+  cv::Mat horLines;
+  cv::Mat verLines;
+
+  cv::Mat blob; // biggest blob of the table
+  BlobBuffers blobScratch;
+
+  cv::Mat hsv; // stamp detection
+  cv::Mat stampMask;
+  cv::Mat stampBlob;
+  BlobBuffers stampScratch; // separate from blobScratch, thumbnail size in gray mode
+  cv::Mat stampPage; // stamp of thumbnail scaled up to the page
+
+  cv::Mat warpColor; // deskew output before it is copied back
+  cv::Mat warpGray;
+  cv::Mat warpSource; // deskew output of the page at source resolution
+
+  Projection projection; // column sums of vertical lines
+  TableGrid grid; // cells of the page
+
+  cv::Mat ink; // non-white pixels of the page
+  cv::Mat inkSum; // its summed-area table
+
+  // Remember image buffers before page, count those reallocated during it. Only the
+  // cv::Mat buffers above are tracked; per-page vectors of line coordinates, cells
+  // and texts, and the vectors of grid and projection, are not counted
+  void BeginPage();
+  void EndPage();
+
+  // Print page and image buffer reallocation counters of all workspaces
+  static void Report(std::ostream &out);
+
+private:
+  std::vector<const uchar *> m_pageBuffers;
+  bool m_warm = false; // at least one page processed
+
+  std::vector<const cv::Mat *> Buffers() const;
+
+  static std::atomic<long long> m_pages;
+  static std::atomic<long long> m_allocations;
+  static std::atomic<long long> m_steadyAllocations; // after first page of a workspace
+};
+
+#endif // PAGEWORKSPACE_H
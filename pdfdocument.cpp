@@ -0,0 +1,1303 @@
+#include "pdfdocument.h"
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  bool IsWhite(char c)
+  {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+  }
+
+  bool IsDelim(char c)
+  {
+    return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' || \
+           c == '{' || c == '}' || c == '/' || c == '%';
+  }
+
+  int HexValue(char c)
+  {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  // Deepest nesting of arrays and dictionaries
+  const int maxNesting = 256;
+
+  // Tokenizer and object parser for PDF syntax
+  class PdfLexer
+  {
+  public:
+    PdfLexer(const char * begin, const char * end): m_begin(begin), m_pos(begin), m_end(end) {}
+
+    size_t Offset() const { return m_pos - m_begin; }
+
+    bool AtEnd()
+    {
+      SkipWhite();
+      return m_pos >= m_end;
+    }
+
+    // Parse object, "n g R" becomes reference, operators come back as keywords.
+    // Depth is the nesting of arrays and dictionaries around the object
+    PdfObject Parse(int depth = 0)
+    {
+      PdfObject obj = ParseToken(depth);
+
+      if(obj.type == PdfObject::Number && obj.number >= 0 && obj.number == std::floor(obj.number))
+      {
+        const char * save = m_pos;
+        PdfObject gen = ParseToken();
+        if(gen.type == PdfObject::Number && gen.number >= 0)
+        {
+          PdfObject r = ParseToken();
+          if(r.type == PdfObject::Keyword && r.text == "R")
+          {
+            PdfObject ref;
+            ref.type = PdfObject::Reference;
+            ref.objNum = obj.number;
+            ref.genNum = gen.number;
+            return ref;
+          }
+        }
+        m_pos = save;
+      }
+
+      return obj;
+    }
+
+    // Skip binary data of inline image after "ID" up to "EI"
+    void SkipInlineImage()
+    {
+      while(m_pos + 2 < m_end)
+      {
+        if(IsWhite(m_pos[0]) && m_pos[1] == 'E' && m_pos[2] == 'I' && (m_pos + 3 == m_end || IsWhite(m_pos[3])))
+        {
+          m_pos += 3;
+          return;
+        }
+        ++m_pos;
+      }
+      m_pos = m_end;
+    }
+
+    // Skip end of line after "stream" keyword
+    void SkipStreamEol()
+    {
+      if(m_pos < m_end && *m_pos == '\r') ++m_pos;
+      if(m_pos < m_end && *m_pos == '\n') ++m_pos;
+    }
+
+  private:
+    const char * m_begin;
+    const char * m_pos;
+    const char * m_end;
+
+    void SkipWhite()
+    {
+      while(m_pos < m_end)
+      {
+        if(IsWhite(*m_pos))
+          ++m_pos;
+        else if(*m_pos == '%')
+        {
+          while(m_pos < m_end && *m_pos != '\n' && *m_pos != '\r')
+            ++m_pos;
+        }
+        else
+          break;
+      }
+    }
+
+    PdfObject ParseToken(int depth = 0)
+    {
+      SkipWhite();
+      PdfObject obj;
+      if(m_pos >= m_end)
+        return obj;
+
+      const char c = *m_pos;
+
+      // Nesting is limited, so a broken file can not exhaust the stack
+      if((c == '[' || (c == '<' && m_pos + 1 < m_end && m_pos[1] == '<')) && depth >= maxNesting)
+        throw std::runtime_error("Objects nested too deep");
+
+      if(c == '[')
+      {
+        ++m_pos;
+        obj.type = PdfObject::Array;
+        for(;;)
+        {
+          if(AtEnd())
+            throw std::runtime_error("Unterminated array");
+          if(*m_pos == ']')
+          {
+            ++m_pos;
+            break;
+          }
+          obj.items.push_back(Parse(depth + 1));
+        }
+      }
+      else if(c == '<' && m_pos + 1 < m_end && m_pos[1] == '<')
+      {
+        m_pos += 2;
+        obj.type = PdfObject::Dictionary;
+        for(;;)
+        {
+          if(AtEnd())
+            throw std::runtime_error("Unterminated dictionary");
+          if(*m_pos == '>' && m_pos + 1 < m_end && m_pos[1] == '>')
+          {
+            m_pos += 2;
+            break;
+          }
+          PdfObject key = ParseToken();
+          if(key.type != PdfObject::Name)
+            throw std::runtime_error("Dictionary key is not a name");
+          obj.dict[key.text] = Parse(depth + 1);
+        }
+      }
+      else if(c == '<')
+      {
+        ++m_pos;
+        obj.type = PdfObject::String;
+        int high = -1;
+        while(m_pos < m_end && *m_pos != '>')
+        {
+          const int v = HexValue(*m_pos++);
+          if(v < 0)
+            continue;
+          if(high < 0)
+            high = v;
+          else
+          {
+            obj.text.push_back(static_cast<char>(high * 16 + v));
+            high = -1;
+          }
+        }
+        if(high >= 0)
+          obj.text.push_back(static_cast<char>(high * 16));
+        ++m_pos;
+      }
+      else if(c == '(')
+      {
+        ++m_pos;
+        obj.type = PdfObject::String;
+        int depth = 1;
+        while(m_pos < m_end)
+        {
+          char ch = *m_pos++;
+          if(ch == '\\' && m_pos < m_end)
+          {
+            ch = *m_pos++;
+            switch(ch)
+            {
+            case 'n': obj.text.push_back('\n'); break;
+            case 'r': obj.text.push_back('\r'); break;
+            case 't': obj.text.push_back('\t'); break;
+            case 'b': obj.text.push_back('\b'); break;
+            case 'f': obj.text.push_back('\f'); break;
+            case '\r': if(m_pos < m_end && *m_pos == '\n') ++m_pos; break;
+            case '\n': break;
+            default:
+              if(ch >= '0' && ch <= '7')
+              {
+                int v = ch - '0';
+                for(int k = 0; k < 2 && m_pos < m_end && *m_pos >= '0' && *m_pos <= '7'; ++k)
+                  v = v * 8 + (*m_pos++ - '0');
+                obj.text.push_back(static_cast<char>(v));
+              }
+              else
+                obj.text.push_back(ch);
+            }
+            continue;
+          }
+          if(ch == '(')
+            ++depth;
+          else if(ch == ')' && --depth == 0)
+            break;
+          obj.text.push_back(ch);
+        }
+      }
+      else if(c == '/')
+      {
+        ++m_pos;
+        obj.type = PdfObject::Name;
+        while(m_pos < m_end && !IsWhite(*m_pos) && !IsDelim(*m_pos))
+        {
+          if(*m_pos == '#' && m_pos + 2 < m_end && HexValue(m_pos[1]) >= 0 && HexValue(m_pos[2]) >= 0)
+          {
+            obj.text.push_back(static_cast<char>(HexValue(m_pos[1]) * 16 + HexValue(m_pos[2])));
+            m_pos += 3;
+          }
+          else
+            obj.text.push_back(*m_pos++);
+        }
+      }
+      else if((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.')
+      {
+        const char * begin = m_pos;
+        ++m_pos;
+        while(m_pos < m_end && ((*m_pos >= '0' && *m_pos <= '9') || *m_pos == '.'))
+          ++m_pos;
+        obj.type = PdfObject::Number;
+        obj.number = std::atof(std::string(begin, m_pos).c_str());
+      }
+      else
+      {
+        // Keyword or single delimiter, e.g. ']' or '{'
+        const char * begin = m_pos;
+        if(IsDelim(c))
+          ++m_pos;
+        else
+        {
+          while(m_pos < m_end && !IsWhite(*m_pos) && !IsDelim(*m_pos))
+            ++m_pos;
+        }
+        obj.text.assign(begin, m_pos);
+
+        if(obj.text == "true" || obj.text == "false")
+        {
+          obj.type = PdfObject::Boolean;
+          obj.boolean = obj.text == "true";
+        }
+        else if(obj.text == "null")
+          obj.type = PdfObject::Null;
+        else
+          obj.type = PdfObject::Keyword;
+      }
+
+      return obj;
+    }
+  };
+
+  // Inflate zlib stream, truncated streams give what could be decoded
+  bool Inflate(const std::string &in, std::string &out)
+  {
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if(inflateInit(&zs) != Z_OK)
+      return false;
+
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs.avail_in = in.size();
+
+    out.clear();
+    char chunk[65536];
+    int code = Z_OK;
+    do
+    {
+      zs.next_out = reinterpret_cast<Bytef *>(chunk);
+      zs.avail_out = sizeof(chunk);
+      code = inflate(&zs, Z_NO_FLUSH);
+      out.append(chunk, sizeof(chunk) - zs.avail_out);
+    }
+    while(code == Z_OK);
+
+    inflateEnd(&zs);
+    return code == Z_STREAM_END || !out.empty();
+  }
+
+  int IntValue(const PdfObject * obj, int def)
+  {
+    return obj && obj->type == PdfObject::Number ? static_cast<int>(obj->number) : def;
+  }
+
+  // Object is in the set of objects being loaded until the guard goes, also on exception
+  struct LoadingGuard
+  {
+    std::set<int> &loading;
+    int objNum;
+    ~LoadingGuard() { loading.erase(objNum); }
+  };
+
+  // Undo PNG or TIFF predictor of Flate stream
+  bool Unpredict(std::string &data, const PdfObject * parms)
+  {
+    const int predictor = IntValue(parms ? parms->Get("Predictor") : nullptr, 1);
+    if(predictor <= 1)
+      return true;
+
+    const int colors = IntValue(parms->Get("Colors"), 1);
+    const int bpc = IntValue(parms->Get("BitsPerComponent"), 8);
+    const int columns = IntValue(parms->Get("Columns"), 1);
+    const size_t bpp = std::max(1, colors * bpc / 8);
+    const size_t rowBytes = (static_cast<size_t>(columns) * colors * bpc + 7) / 8;
+
+    if(predictor == 2)
+    {
+      if(bpc != 8)
+        return false;
+      for(size_t row = 0; row + rowBytes <= data.size(); row += rowBytes)
+      {
+        for(size_t i = bpp; i < rowBytes; ++i)
+          data[row + i] = static_cast<char>(data[row + i] + data[row + i - bpp]);
+      }
+      return true;
+    }
+
+    // PNG predictors, every row starts with filter type
+    std::string out;
+    out.reserve(data.size() / (rowBytes + 1) * rowBytes);
+    std::vector<unsigned char> prev(rowBytes, 0), cur(rowBytes);
+
+    for(size_t pos = 0; pos + rowBytes + 1 <= data.size(); pos += rowBytes + 1)
+    {
+      const int filter = static_cast<unsigned char>(data[pos]);
+      const unsigned char * src = reinterpret_cast<const unsigned char *>(data.data() + pos + 1);
+
+      for(size_t i = 0; i < rowBytes; ++i)
+      {
+        const int left = i >= bpp ? cur[i - bpp] : 0;
+        const int up = prev[i];
+        const int upLeft = i >= bpp ? prev[i - bpp] : 0;
+        int value = src[i];
+
+        switch(filter)
+        {
+        case 0: break;
+        case 1: value += left; break;
+        case 2: value += up; break;
+        case 3: value += (left + up) / 2; break;
+        case 4:
+        {
+          const int p = left + up - upLeft;
+          const int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+          value += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+          break;
+        }
+        default: return false;
+        }
+        cur[i] = static_cast<unsigned char>(value);
+      }
+
+      out.append(reinterpret_cast<const char *>(cur.data()), rowBytes);
+      prev.swap(cur);
+    }
+
+    data.swap(out);
+    return true;
+  }
+
+  // m * ctm, PDF matrices [a b c d e f]
+  void Concat(const double m[6], double ctm[6])
+  {
+    const double r[6] =
+    {
+      m[0] * ctm[0] + m[1] * ctm[2],
+      m[0] * ctm[1] + m[1] * ctm[3],
+      m[2] * ctm[0] + m[3] * ctm[2],
+      m[2] * ctm[1] + m[3] * ctm[3],
+      m[4] * ctm[0] + m[5] * ctm[2] + ctm[4],
+      m[4] * ctm[1] + m[5] * ctm[3] + ctm[5]
+    };
+    std::copy(r, r + 6, ctm);
+  }
+}
+
+PdfDocument::PdfDocument(const std::string &fileName):
+  m_file(fileName)
+{
+  if(!m_file.IsOpen())
+  {
+    std::cerr << "Error opening file " << fileName << std::endl;
+    return;
+  }
+
+  // Cross-reference first, scan of the whole file if it is broken
+  for(int attempt = 0; attempt < 2 && m_pages.empty(); ++attempt)
+  {
+    try
+    {
+      if(attempt == 1 || !LoadXref())
+      {
+        if(m_scanned)
+          break;
+        m_offsets.clear();
+        m_compressed.clear();
+        m_cache.clear();
+        IndexObjects();
+        if(!FindTrailer())
+          throw std::runtime_error("Document catalog is not found");
+      }
+
+      const PdfObject root = Resolve(*m_trailer.Get("Root"));
+      const PdfObject * pages = root.Get("Pages");
+      if(!pages)
+        throw std::runtime_error("Page tree is not found");
+
+      CollectPages(Resolve(*pages), Page(), 0);
+
+      for(auto &page:m_pages)
+        ClassifyPage(page);
+    }
+    catch(std::exception const &ex)
+    {
+      std::cerr << "Could not parse PDF structure: " << ex.what() << std::endl;
+      m_pages.clear();
+    }
+  }
+}
+
+bool PdfDocument::LoadXref()
+{
+  const size_t startxref = m_file.RFind("startxref");
+  if(startxref == std::string::npos)
+    return false;
+
+  try
+  {
+    PdfLexer lexer(m_file.Data() + startxref + 9, m_file.Data() + m_file.Size());
+    const PdfObject first = lexer.Parse();
+    if(first.type != PdfObject::Number)
+      return false;
+
+    // Walk sections from the newest, entries already known are newer
+    std::vector<size_t> visited;
+    size_t offset = first.number;
+    while(offset < m_file.Size() && std::find(visited.begin(), visited.end(), offset) == visited.end())
+    {
+      visited.push_back(offset);
+
+      PdfObject trailer;
+      if(m_file.Find("xref", offset, 4) == offset)
+      {
+        ParseXrefTable(offset + 4, trailer);
+
+        // Hybrid files keep compressed objects in additional xref stream
+        if(const PdfObject * xrefStm = trailer.Get("XRefStm"))
+          ParseXrefStream(ParseAt(xrefStm->number));
+      }
+      else
+      {
+        trailer = ParseAt(offset);
+        if(trailer.type != PdfObject::Stream || !trailer.Get("Type") || !trailer.Get("Type")->IsName("XRef"))
+          return false;
+        ParseXrefStream(trailer);
+      }
+
+      if(m_trailer.type == PdfObject::Null)
+        m_trailer = trailer;
+
+      const PdfObject * prev = trailer.Get("Prev");
+      if(!prev || prev->type != PdfObject::Number)
+        break;
+      offset = prev->number;
+    }
+  }
+  catch(std::exception const &ex)
+  {
+    std::cerr << "Broken cross-reference, scanning objects: " << ex.what() << std::endl;
+  }
+
+  m_cache.clear(); // objects loaded while sections were incomplete
+
+  if(!m_trailer.Get("Root") || m_offsets.empty())
+  {
+    m_offsets.clear();
+    m_compressed.clear();
+    m_trailer = PdfObject();
+    return false;
+  }
+
+  return true;
+}
+
+void PdfDocument::ParseXrefTable(size_t offset, PdfObject &trailer)
+{
+  PdfLexer lexer(m_file.Data() + offset, m_file.Data() + m_file.Size());
+
+  for(;;)
+  {
+    const PdfObject start = lexer.Parse();
+    if(start.type == PdfObject::Keyword && start.text == "trailer")
+    {
+      trailer = lexer.Parse();
+      return;
+    }
+
+    const PdfObject count = lexer.Parse();
+    if(start.type != PdfObject::Number || count.type != PdfObject::Number)
+      throw std::runtime_error("Broken xref subsection");
+
+    for(int i = 0; i < count.number; ++i)
+    {
+      const PdfObject entryOffset = lexer.Parse();
+      lexer.Parse(); // generation
+      const PdfObject kind = lexer.Parse();
+      const int objNum = start.number + i;
+
+      if(kind.text == "n" && !m_offsets.count(objNum) && !m_compressed.count(objNum))
+        m_offsets[objNum] = entryOffset.number;
+      else if(kind.text != "n" && kind.text != "f")
+        throw std::runtime_error("Broken xref entry");
+    }
+  }
+}
+
+void PdfDocument::ParseXrefStream(const PdfObject &stream)
+{
+  std::string data, imageFilter;
+  if(stream.type != PdfObject::Stream || !DecodeStream(stream, data, imageFilter) || !imageFilter.empty())
+    throw std::runtime_error("Could not decode xref stream");
+
+  const PdfObject * w = stream.Get("W");
+  if(!w || w->items.size() != 3)
+    throw std::runtime_error("Xref stream without /W");
+
+  const int widths[3] = {IntValue(&w->items[0], 0), IntValue(&w->items[1], 0), IntValue(&w->items[2], 0)};
+  const size_t entrySize = widths[0] + widths[1] + widths[2];
+
+  std::vector<int> index;
+  if(const PdfObject * idx = stream.Get("Index"))
+    for(auto &v:idx->items) index.push_back(v.number);
+  else
+    index = {0, IntValue(stream.Get("Size"), 0)};
+
+  size_t pos = 0;
+  for(size_t section = 0; section + 1 < index.size(); section += 2)
+  {
+    for(int i = 0; i < index[section + 1] && pos + entrySize <= data.size(); ++i)
+    {
+      long long fields[3] = {1, 0, 0}; // type defaults to 1
+      for(int f = 0; f < 3; ++f)
+      {
+        if(widths[f] == 0)
+          continue;
+        fields[f] = 0;
+        for(int b = 0; b < widths[f]; ++b)
+          fields[f] = (fields[f] << 8) | static_cast<unsigned char>(data[pos++]);
+      }
+
+      const int objNum = index[section] + i;
+      if(m_offsets.count(objNum) || m_compressed.count(objNum))
+        continue;
+
+      if(fields[0] == 1)
+        m_offsets[objNum] = fields[1];
+      else if(fields[0] == 2)
+        m_compressed[objNum] = std::make_pair(static_cast<int>(fields[1]), static_cast<int>(fields[2]));
+    }
+  }
+}
+
+void PdfDocument::IndexObjects()
+{
+  // Find "num gen obj" headers, later definitions win like incremental updates
+  std::vector<int> objectStreams;
+  m_scanned = true;
+
+  for(size_t pos = m_file.Find("obj"); pos != std::string::npos; pos = m_file.Find("obj", pos + 3))
+  {
+    if(pos + 3 < m_file.Size() && !IsWhite(m_file[pos + 3]) && !IsDelim(m_file[pos + 3]))
+      continue;
+
+    size_t p = pos;
+    auto skipWhite = [&]() -> bool
+    {
+      const size_t before = p;
+      while(p > 0 && IsWhite(m_file[p - 1])) --p;
+      return p != before;
+    };
+    auto skipDigits = [&]() -> bool
+    {
+      const size_t before = p;
+      while(p > 0 && std::isdigit(static_cast<unsigned char>(m_file[p - 1]))) --p;
+      return p != before;
+    };
+
+    if(!skipWhite() || !skipDigits() || !skipWhite() || !skipDigits())
+      continue;
+    if(p > 0 && !IsWhite(m_file[p - 1]) && !IsDelim(m_file[p - 1]))
+      continue;
+
+    const int objNum = std::atoi(m_file.Data() + p);
+    m_offsets[objNum] = p;
+
+    if(m_file.Find("/ObjStm", pos, 256) != std::string::npos)
+      objectStreams.push_back(objNum);
+  }
+
+  for(int streamNum:objectStreams)
+  {
+    try
+    {
+      IndexObjectStream(streamNum);
+    }
+    catch(std::exception const &ex)
+    {
+      std::cerr << "Skipping object stream " << streamNum << ": " << ex.what() << std::endl;
+    }
+  }
+}
+
+void PdfDocument::IndexObjectStream(int streamNum)
+{
+  const PdfObject stream = Load(streamNum);
+  if(stream.type != PdfObject::Stream)
+    return;
+
+  std::string data, imageFilter;
+  if(!DecodeStream(stream, data, imageFilter) || !imageFilter.empty())
+    return;
+
+  const int count = IntValue(stream.Get("N"), 0);
+  PdfLexer lexer(data.data(), data.data() + data.size());
+  for(int i = 0; i < count; ++i)
+  {
+    const PdfObject num = lexer.Parse();
+    lexer.Parse(); // offset, resolved on load
+    if(num.type == PdfObject::Number && !m_offsets.count(num.number))
+      m_compressed[num.number] = std::make_pair(streamNum, i);
+  }
+}
+
+bool PdfDocument::FindTrailer()
+{
+  // Classic trailer dictionary
+  for(size_t pos = m_file.RFind("trailer"); pos != std::string::npos; pos = pos ? m_file.RFind("trailer", pos - 1) : std::string::npos)
+  {
+    PdfLexer lexer(m_file.Data() + pos + 7, m_file.Data() + m_file.Size());
+    const PdfObject trailer = lexer.Parse();
+    if(trailer.Get("Root"))
+    {
+      m_trailer = trailer;
+      return true;
+    }
+  }
+
+  // Cross-reference stream or bare catalog, the last one wins
+  for(auto it = m_offsets.rbegin(); it != m_offsets.rend(); ++it)
+  {
+    const PdfObject obj = Load(it->first);
+    if(obj.Get("Root") && obj.Get("Type") && obj.Get("Type")->IsName("XRef"))
+    {
+      m_trailer = obj;
+      return true;
+    }
+  }
+
+  for(auto it = m_offsets.rbegin(); it != m_offsets.rend(); ++it)
+  {
+    const PdfObject obj = Load(it->first);
+    if(obj.Get("Type") && obj.Get("Type")->IsName("Catalog"))
+    {
+      m_trailer = PdfObject();
+      m_trailer.type = PdfObject::Dictionary;
+      m_trailer.dict["Root"].type = PdfObject::Reference;
+      m_trailer.dict["Root"].objNum = it->first;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void PdfDocument::CollectPages(const PdfObject &node, const Page &inherited, int depth)
+{
+  if(depth > 64)
+    throw std::runtime_error("Page tree is too deep");
+
+  Page page = inherited;
+  if(const PdfObject * resources = node.Get("Resources"))
+    page.resources = Resolve(*resources);
+  if(const PdfObject * mediaBox = node.Get("MediaBox"))
+  {
+    const PdfObject box = Resolve(*mediaBox);
+    page.mediaBox.clear();
+    for(auto &v:box.items)
+      page.mediaBox.push_back(Resolve(v).number);
+  }
+  if(const PdfObject * rotate = node.Get("Rotate"))
+    page.rotate = static_cast<int>(Resolve(*rotate).number);
+
+  const PdfObject * kids = node.Get("Kids");
+  if(!kids)
+  {
+    page.dict = node;
+    m_pages.push_back(page);
+    return;
+  }
+
+  const PdfObject kidsArray = Resolve(*kids);
+  for(auto &kid:kidsArray.items)
+    CollectPages(Resolve(kid), page, depth + 1);
+}
+
+PdfObject PdfDocument::ParseAt(size_t offset, int *objNum) const
+{
+  if(offset >= m_file.Size())
+    throw std::runtime_error("Object offset is out of file");
+
+  PdfLexer lexer(m_file.Data() + offset, m_file.Data() + m_file.Size());
+
+  const PdfObject num = lexer.Parse();
+  const PdfObject gen = lexer.Parse();
+  const PdfObject keyword = lexer.Parse();
+  if(num.type != PdfObject::Number || gen.type != PdfObject::Number || keyword.text != "obj")
+    throw std::runtime_error("Broken object header");
+  if(objNum)
+    *objNum = num.number;
+
+  PdfObject obj = lexer.Parse();
+  if(obj.type != PdfObject::Dictionary)
+    return obj;
+
+  const PdfObject next = lexer.Parse();
+  if(next.type != PdfObject::Keyword || next.text != "stream")
+    return obj;
+
+  lexer.SkipStreamEol();
+  obj.type = PdfObject::Stream;
+  obj.streamBegin = offset + lexer.Offset();
+
+  // Trust /Length only if "endstream" follows it
+  const PdfObject * length = obj.Get("Length");
+  if(length)
+  {
+    // Length that refers back to the stream being loaded is unknown, the stream is scanned for its end
+    PdfObject len = *length;
+    if(length->type == PdfObject::Reference)
+    {
+      try
+      {
+        len = Load(length->objNum);
+      }
+      catch(std::exception const &)
+      {
+        len = PdfObject();
+      }
+    }
+    if(len.type == PdfObject::Number && len.number >= 0 && obj.streamBegin + len.number <= m_file.Size())
+    {
+      const size_t end = obj.streamBegin + static_cast<size_t>(len.number);
+      if(m_file.Find("endstream", end, 11) != std::string::npos)
+      {
+        obj.streamLength = len.number;
+        return obj;
+      }
+    }
+  }
+
+  size_t end = m_file.Find("endstream", obj.streamBegin);
+  if(end == std::string::npos)
+    throw std::runtime_error("Unterminated stream");
+  if(end > obj.streamBegin && m_file[end - 1] == '\n') --end;
+  if(end > obj.streamBegin && m_file[end - 1] == '\r') --end;
+  obj.streamLength = end - obj.streamBegin;
+
+  return obj;
+}
+
+PdfObject PdfDocument::Load(int objNum) const
+{
+  auto cached = m_cache.find(objNum);
+  if(cached != m_cache.end())
+    return cached->second;
+
+  if(!m_loading.insert(objNum).second)
+    throw std::runtime_error("Object " + std::to_string(objNum) + " refers to itself");
+  LoadingGuard guard{m_loading, objNum};
+
+  PdfObject obj;
+
+  auto direct = m_offsets.find(objNum);
+  auto compressed = m_compressed.find(objNum);
+  if(direct != m_offsets.end())
+  {
+    obj = ParseAt(direct->second);
+  }
+  else if(compressed != m_compressed.end())
+  {
+    const PdfObject stream = Load(compressed->second.first);
+    std::string data, imageFilter;
+    if(!DecodeStream(stream, data, imageFilter))
+      throw std::runtime_error("Could not decode object stream");
+
+    const int count = IntValue(stream.Get("N"), 0);
+    const int first = IntValue(stream.Get("First"), 0);
+
+    // Header is pairs of object number and offset relative to /First
+    PdfLexer header(data.data(), data.data() + data.size());
+    int offset = -1;
+    for(int i = 0; i < count && i <= compressed->second.second; ++i)
+    {
+      header.Parse();
+      const PdfObject rel = header.Parse();
+      offset = IntValue(&rel, -1);
+    }
+    if(offset < 0 || first + offset >= static_cast<int>(data.size()))
+      throw std::runtime_error("Broken object stream");
+
+    PdfLexer lexer(data.data() + first + offset, data.data() + data.size());
+    obj = lexer.Parse();
+  }
+  else
+  {
+    return obj; // missing objects are null, not cached while xref is being read
+  }
+
+  m_cache[objNum] = obj;
+  return obj;
+}
+
+PdfObject PdfDocument::Resolve(const PdfObject &obj) const
+{
+  PdfObject result = obj;
+  for(int depth = 0; result.type == PdfObject::Reference && depth < 32; ++depth)
+    result = Load(result.objNum);
+  return result;
+}
+
+bool PdfDocument::DecodeStream(const PdfObject &stream, std::string &data, std::string &imageFilter) const
+{
+  data.assign(m_file.Data() + stream.streamBegin, stream.streamLength);
+  imageFilter.clear();
+
+  std::vector<PdfObject> filters, parms;
+  if(const PdfObject * filter = stream.Get("Filter"))
+  {
+    const PdfObject f = Resolve(*filter);
+    if(f.type == PdfObject::Array)
+      for(auto &item:f.items) filters.push_back(Resolve(item));
+    else if(f.type == PdfObject::Name)
+      filters.push_back(f);
+  }
+  if(const PdfObject * decodeParms = stream.Get("DecodeParms"))
+  {
+    const PdfObject p = Resolve(*decodeParms);
+    if(p.type == PdfObject::Array)
+      for(auto &item:p.items) parms.push_back(Resolve(item));
+    else
+      parms.push_back(p);
+  }
+
+  for(size_t i = 0; i < filters.size(); ++i)
+  {
+    const std::string &name = filters[i].text;
+    const PdfObject * parm = i < parms.size() && parms[i].type == PdfObject::Dictionary ? &parms[i] : nullptr;
+
+    if(name == "FlateDecode" || name == "Fl")
+    {
+      std::string out;
+      if(!Inflate(data, out) || !Unpredict(out, parm))
+        return false;
+      data.swap(out);
+    }
+    else if(name == "DCTDecode" || name == "DCT")
+    {
+      imageFilter = "DCTDecode";
+      return i + 1 == filters.size();
+    }
+    else
+    {
+      // CCITTFax, JBIG2, JPX, LZW etc. are left for Ghostscript
+      imageFilter = name;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool PdfDocument::ScanContent(const std::string &content, const PdfObject &resources, const double ctm[6], \
+                              PageContent &result, int depth) const
+{
+  if(depth > 8)
+    return false;
+
+  PdfObject xobjects;
+  if(const PdfObject * x = resources.Get("XObject"))
+    xobjects = Resolve(*x);
+
+  std::vector<PdfObject> operands;
+  std::vector<std::vector<double>> stack;
+  double cur[6];
+  std::copy(ctm, ctm + 6, cur);
+
+  PdfLexer lexer(content.data(), content.data() + content.size());
+  while(!lexer.AtEnd())
+  {
+    PdfObject token = lexer.Parse();
+    if(token.type != PdfObject::Keyword)
+    {
+      operands.push_back(token);
+      continue;
+    }
+
+    const std::string &op = token.text;
+    if(op == "q")
+    {
+      stack.emplace_back(cur, cur + 6);
+    }
+    else if(op == "Q")
+    {
+      if(!stack.empty())
+      {
+        std::copy(stack.back().begin(), stack.back().end(), cur);
+        stack.pop_back();
+      }
+    }
+    else if(op == "cm")
+    {
+      if(operands.size() < 6)
+        return false;
+      double m[6];
+      for(int i = 0; i < 6; ++i)
+        m[i] = operands[operands.size() - 6 + i].number;
+      Concat(m, cur);
+    }
+    else if(op == "Do")
+    {
+      if(operands.empty() || operands.back().type != PdfObject::Name)
+        return false;
+      const PdfObject * ref = xobjects.Get(operands.back().text);
+      if(!ref)
+        return false;
+      const PdfObject xobject = Resolve(*ref);
+      const PdfObject * subtype = xobject.Get("Subtype");
+
+      if(subtype && subtype->IsName("Image"))
+      {
+        ++result.images;
+        result.image = xobject;
+        std::copy(cur, cur + 6, result.ctm);
+      }
+      else if(subtype && subtype->IsName("Form"))
+      {
+        std::string formContent, imageFilter;
+        if(xobject.type != PdfObject::Stream || !DecodeStream(xobject, formContent, imageFilter) || !imageFilter.empty())
+          return false;
+
+        double formCtm[6];
+        std::copy(cur, cur + 6, formCtm);
+        if(const PdfObject * matrix = xobject.Get("Matrix"))
+        {
+          if(matrix->items.size() == 6)
+          {
+            double m[6];
+            for(int i = 0; i < 6; ++i)
+              m[i] = Resolve(matrix->items[i]).number;
+            Concat(m, formCtm);
+          }
+        }
+
+        const PdfObject * formResources = xobject.Get("Resources");
+        if(!ScanContent(formContent, formResources ? Resolve(*formResources) : resources, formCtm, result, depth + 1))
+          return false;
+      }
+    }
+    else if(op == "ID")
+    {
+      // Inline image can't be taken without rendering
+      ++result.images;
+      result.paths = true;
+      lexer.SkipInlineImage();
+    }
+    else if(op == "Tj" || op == "TJ" || op == "'" || op == "\"")
+    {
+      result.text = true;
+    }
+    else if(op == "S" || op == "s" || op == "f" || op == "F" || op == "f*" || op == "B" || op == "B*" || \
+            op == "b" || op == "b*" || op == "sh")
+    {
+      result.paths = true;
+    }
+
+    operands.clear();
+  }
+
+  return true;
+}
+
+void PdfDocument::ClassifyPage(Page &page) const
+{
+  // Concatenate content streams
+  std::string content;
+  if(const PdfObject * contents = page.dict.Get("Contents"))
+  {
+    PdfObject c = Resolve(*contents);
+    std::vector<PdfObject> streams;
+    if(c.type == PdfObject::Array)
+      for(auto &item:c.items) streams.push_back(Resolve(item));
+    else
+      streams.push_back(c);
+
+    for(auto &s:streams)
+    {
+      std::string data, imageFilter;
+      if(s.type != PdfObject::Stream || !DecodeStream(s, data, imageFilter) || !imageFilter.empty())
+      {
+        page.kind = Mixed; // unknown content is left for Ghostscript
+        return;
+      }
+      content += data;
+      content += '\n';
+    }
+  }
+
+  const double identity[6] = {1, 0, 0, 1, 0, 0};
+  if(!ScanContent(content, page.resources, identity, page.content, 0))
+  {
+    page.kind = Mixed;
+    page.content.images = 0;
+    return;
+  }
+
+  if(page.content.images == 0)
+    page.kind = Vector;
+  else if(page.content.text || page.content.paths)
+    page.kind = Mixed;
+  else
+    page.kind = Raster;
+}
+
+int PdfDocument::CountPages(PageKind kind) const
+{
+  return std::count_if(m_pages.begin(), m_pages.end(), [kind](const Page &page){ return page.kind == kind; });
+}
+
+bool PdfDocument::HasImages() const
+{
+  if(IsValid())
+    return CountPages(Raster) + CountPages(Mixed) > 0;
+
+  return m_file.Find("/Image") != std::string::npos;
+}
+
+bool PdfDocument::DecodeImage(const PdfObject &stream, cv::Mat &image, const cv::Size &target) const
+{
+  const PdfObject * imageMask = stream.Get("ImageMask");
+  if(imageMask && imageMask->boolean)
+    return false;
+
+  const int width = IntValue(stream.Get("Width"), 0);
+  const int height = IntValue(stream.Get("Height"), 0);
+  const int bpc = IntValue(stream.Get("BitsPerComponent"), 8);
+  if(width <= 0 || height <= 0)
+    return false;
+
+  std::string data, imageFilter;
+  if(!DecodeStream(stream, data, imageFilter))
+    return false;
+
+  if(imageFilter == "DCTDecode")
+  {
+    // libjpeg scales by 1/2, 1/4 or 1/8 while decoding, pixels above target are never produced
+    int flags = cv::IMREAD_COLOR;
+    if(target.area() > 0)
+    {
+      const int reduce = std::min(width / target.width, height / target.height);
+      flags = reduce >= 8 ? cv::IMREAD_REDUCED_COLOR_8 : reduce >= 4 ? cv::IMREAD_REDUCED_COLOR_4 : \
+              reduce >= 2 ? cv::IMREAD_REDUCED_COLOR_2 : cv::IMREAD_COLOR;
+    }
+
+    const cv::Mat buf(1, data.size(), CV_8U, const_cast<char *>(data.data()));
+    image = cv::imdecode(buf, flags);
+    return !image.empty();
+  }
+
+  // Raw samples: resolve color space and optional palette
+  PdfObject colorSpace;
+  if(const PdfObject * cs = stream.Get("ColorSpace"))
+    colorSpace = Resolve(*cs);
+
+  int components = 0;
+  std::string palette; // RGB triples of indexed image
+  auto componentsOf = [this](const PdfObject &cs) -> int
+  {
+    const PdfObject family = cs.type == PdfObject::Array && !cs.items.empty() ? Resolve(cs.items[0]) : cs;
+    if(family.IsName("DeviceGray") || family.IsName("CalGray") || family.IsName("G")) return 1;
+    if(family.IsName("DeviceRGB") || family.IsName("CalRGB") || family.IsName("RGB")) return 3;
+    if(family.IsName("DeviceCMYK") || family.IsName("CMYK")) return 4;
+    if(family.IsName("ICCBased") && cs.items.size() > 1)
+      return IntValue(Resolve(cs.items[1]).Get("N"), 0);
+    return 0;
+  };
+
+  if(colorSpace.type == PdfObject::Array && !colorSpace.items.empty() && \
+     (Resolve(colorSpace.items[0]).IsName("Indexed") || Resolve(colorSpace.items[0]).IsName("I")))
+  {
+    if(colorSpace.items.size() < 4)
+      return false;
+    const int baseComponents = componentsOf(Resolve(colorSpace.items[1]));
+    const PdfObject hivalObj = Resolve(colorSpace.items[2]);
+    const int hival = IntValue(&hivalObj, -1);
+    const PdfObject lookup = Resolve(colorSpace.items[3]);
+
+    std::string table = lookup.text, imageFilterLookup;
+    if(lookup.type == PdfObject::Stream && (!DecodeStream(lookup, table, imageFilterLookup) || !imageFilterLookup.empty()))
+      return false;
+    if((baseComponents != 1 && baseComponents != 3) || hival < 0 || table.size() < static_cast<size_t>((hival + 1) * baseComponents))
+      return false;
+
+    for(int i = 0; i <= 255; ++i)
+    {
+      const int idx = std::min(i, hival) * baseComponents;
+      for(int ch = 0; ch < 3; ++ch)
+        palette.push_back(table[idx + (baseComponents == 3 ? ch : 0)]);
+    }
+    components = 1;
+  }
+  else
+  {
+    components = componentsOf(colorSpace);
+  }
+
+  if(components != 1 && components != 3 && components != 4)
+    return false;
+  if(bpc != 8 && !(components == 1 && (bpc == 1 || bpc == 2 || bpc == 4)))
+    return false;
+
+  const size_t rowBytes = (static_cast<size_t>(width) * components * bpc + 7) / 8;
+  if(data.size() < rowBytes * height)
+    return false;
+
+  // Inverted /Decode [1 0] of gray images
+  bool invert = false;
+  if(const PdfObject * decode = stream.Get("Decode"))
+  {
+    const PdfObject d = Resolve(*decode);
+    if(d.items.size() >= 2 && d.items[0].number > d.items[1].number)
+    {
+      if(components != 1 || !palette.empty())
+        return false;
+      invert = true;
+    }
+  }
+
+  image.create(height, width, CV_8UC3);
+  const int maxValue = (1 << bpc) - 1;
+
+  for(int y = 0; y < height; ++y)
+  {
+    const unsigned char * src = reinterpret_cast<const unsigned char *>(data.data()) + rowBytes * y;
+    unsigned char * dst = image.ptr(y);
+
+    for(int x = 0; x < width; ++x, dst += 3)
+    {
+      if(components == 3)
+      {
+        dst[0] = src[3 * x + 2];
+        dst[1] = src[3 * x + 1];
+        dst[2] = src[3 * x];
+      }
+      else if(components == 4)
+      {
+        const int k = 255 - src[4 * x + 3];
+        dst[0] = (255 - src[4 * x + 2]) * k / 255;
+        dst[1] = (255 - src[4 * x + 1]) * k / 255;
+        dst[2] = (255 - src[4 * x]) * k / 255;
+      }
+      else
+      {
+        int value = src[x];
+        if(bpc < 8)
+        {
+          const int bit = x * bpc;
+          value = (src[bit / 8] >> (8 - bpc - bit % 8)) & maxValue;
+        }
+
+        if(!palette.empty())
+        {
+          dst[0] = palette[3 * value + 2];
+          dst[1] = palette[3 * value + 1];
+          dst[2] = palette[3 * value];
+        }
+        else
+        {
+          if(invert)
+            value = maxValue - value;
+          dst[0] = dst[1] = dst[2] = static_cast<unsigned char>(value * 255 / maxValue);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+cv::Size2d PdfDocument::PageSize(int pageIdx) const
+{
+  if(pageIdx < 0 || pageIdx >= PageCount() || m_pages[pageIdx].mediaBox.size() != 4)
+    return cv::Size2d();
+
+  const Page &page = m_pages[pageIdx];
+  const double pageW = std::abs(page.mediaBox[2] - page.mediaBox[0]);
+  const double pageH = std::abs(page.mediaBox[3] - page.mediaBox[1]);
+  const int rotate = ((page.rotate % 360) + 360) % 360;
+  return rotate == 90 || rotate == 270 ? cv::Size2d(pageH, pageW) : cv::Size2d(pageW, pageH);
+}
+
+bool PdfDocument::ExtractPageImage(int pageIdx, cv::Mat &image, const cv::Size &target) const
+{
+  if(pageIdx < 0 || pageIdx >= PageCount())
+    return false;
+
+  try
+  {
+    const Page &page = m_pages[pageIdx];
+    if(page.mediaBox.size() != 4)
+      return false;
+
+    if(page.kind != Raster || page.content.images != 1)
+      return false;
+
+    // Image should be upright and cover the whole page, like Ghostscript would render it
+    const double * m = page.content.ctm;
+    const double pageW = page.mediaBox[2] - page.mediaBox[0];
+    const double pageH = page.mediaBox[3] - page.mediaBox[1];
+    const double tolW = pageW * 0.02, tolH = pageH * 0.02;
+
+    if(m[0] <= 0 || m[3] <= 0 || std::abs(m[1]) > tolH || std::abs(m[2]) > tolW || \
+       std::abs(m[0] - pageW) > tolW || std::abs(m[3] - pageH) > tolH || \
+       std::abs(m[4] - page.mediaBox[0]) > tolW || std::abs(m[5] - page.mediaBox[1]) > tolH)
+      return false;
+
+    // Target is upright, the image is stored before /Rotate
+    const int rotate = ((page.rotate % 360) + 360) % 360;
+    const cv::Size stored = rotate == 90 || rotate == 270 ? cv::Size(target.height, target.width) : target;
+    if(!DecodeImage(page.content.image, image, stored))
+      return false;
+
+    // Apply /Rotate clockwise
+    switch(rotate)
+    {
+    case 0:
+      break;
+    case 90:
+      cv::transpose(image, image);
+      cv::flip(image, image, 1);
+      break;
+    case 180:
+      cv::flip(image, image, -1);
+      break;
+    case 270:
+      cv::transpose(image, image);
+      cv::flip(image, image, 0);
+      break;
+    default:
+      return false;
+    }
+
+    return true;
+  }
+  catch(std::exception const &ex)
+  {
+    std::cerr << "Could not extract image of page " << pageIdx << ": " << ex.what() << std::endl;
+    return false;
+  }
+}
@@ -0,0 +1,131 @@
+#ifndef PDFDOCUMENT_H
+#define PDFDOCUMENT_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "mappedfile.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Value of PDF object model
+struct PdfObject
+{
+  enum Type {Null, Boolean, Number, Name, String, Keyword, Array, Dictionary, Reference, Stream};
+
+  Type type = Null;
+  bool boolean = false;
+  double number = 0;
+  std::string text; // name, string or keyword
+  std::vector<PdfObject> items; // array
+  std::map<std::string, PdfObject> dict; // dictionary or stream dictionary
+  int objNum = 0; // reference
+  int genNum = 0;
+  size_t streamBegin = 0; // offset of stream data in file
+  size_t streamLength = 0;
+
+  bool IsName(const char * name) const { return type == Name && text == name; }
+
+  // Entry of dictionary or stream, nullptr if missing
+  const PdfObject * Get(const std::string &key) const
+  {
+    auto it = dict.find(key);
+    return it == dict.end() ? nullptr : &it->second;
+  }
+};
+
+/* Minimal PDF reader for raster documents.
+ * The file is memory-mapped and indexed once: cross-reference tables or
+ * streams give the object offsets (a scan for "obj" headers is the
+ * fallback for broken files), the page tree gives the pages and their
+ * content streams tell whether a page is a scan, vector graphics or both.
+ * Pages that consist of a single image XObject are decoded at native
+ * resolution instead of being rendered.
+ * Not thread-safe, loaded objects are cached.
+ */
+class PdfDocument
+{
+public:
+  enum PageKind {Raster, Vector, Mixed};
+
+  explicit PdfDocument(const std::string &fileName);
+
+  bool IsOpen() const { return m_file.IsOpen(); }
+
+  // File was parsed and page tree was found
+  bool IsValid() const { return !m_pages.empty(); }
+
+  int PageCount() const { return m_pages.size(); }
+
+  // Images only, no images at all or images together with text and paths
+  PageKind Kind(int pageIdx) const { return m_pages[pageIdx].kind; }
+
+  // Number of pages of given kind
+  int CountPages(PageKind kind) const;
+
+  // File contains image XObjects at all, also for files with broken structure
+  bool HasImages() const;
+
+  // Size of page in points as it is displayed, /Rotate applied; empty if MediaBox is missing
+  cv::Size2d PageSize(int pageIdx) const;
+
+  // Decode the only image of page at native resolution, false if page does not fit this pattern.
+  // JPEG scans at least twice as big as target are reduced while decoding
+  bool ExtractPageImage(int pageIdx, cv::Mat &image, const cv::Size &target = cv::Size()) const;
+
+private:
+  // What content stream of a page draws
+  struct PageContent
+  {
+    int images = 0;
+    bool text = false;
+    bool paths = false;
+    PdfObject image; // the last image XObject
+    double ctm[6] = {1, 0, 0, 1, 0, 0}; // its placement in default user space
+  };
+
+  struct Page
+  {
+    PdfObject dict;
+    PdfObject resources; // inherited from parents if missing
+    std::vector<double> mediaBox;
+    int rotate = 0;
+    PageKind kind = Mixed;
+    PageContent content;
+  };
+
+  MappedFile m_file;
+  std::map<int, size_t> m_offsets; // object number -> offset of "N G obj"
+  std::map<int, std::pair<int, int>> m_compressed; // object number -> object stream, index
+  PdfObject m_trailer;
+  std::vector<Page> m_pages;
+  bool m_scanned = false; // offsets come from scan, not from xref
+
+  mutable std::map<int, PdfObject> m_cache;
+  mutable std::set<int> m_loading; // objects being loaded, a reference back to one of them is a loop
+
+  bool LoadXref();
+  void ParseXrefTable(size_t offset, PdfObject &trailer);
+  void ParseXrefStream(const PdfObject &stream);
+  void IndexObjects();
+  void IndexObjectStream(int streamNum);
+  bool FindTrailer();
+  void CollectPages(const PdfObject &node, const Page &inherited, int depth);
+
+  PdfObject Load(int objNum) const;
+  PdfObject Resolve(const PdfObject &obj) const;
+  PdfObject ParseAt(size_t offset, int *objNum = nullptr) const;
+
+  // Apply stream filters, stops at image codec and returns its name in imageFilter
+  bool DecodeStream(const PdfObject &stream, std::string &data, std::string &imageFilter) const;
+
+  // Follow graphics state of content stream, forms are scanned recursively
+  bool ScanContent(const std::string &content, const PdfObject &resources, const double ctm[6], \
+                   PageContent &result, int depth) const;
+  void ClassifyPage(Page &page) const;
+  bool DecodeImage(const PdfObject &stream, cv::Mat &image, const cv::Size &target) const;
+};
+
+#endif // PDFDOCUMENT_H
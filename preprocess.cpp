@@ -0,0 +1,202 @@
+#include "preprocess.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PREPROCESS_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  // Sigma of the unsharp mask in SharpnessInc
+  const double sharpenSigma = 3;
+
+  // 3 * s - b is an integer, its half is rounded to even
+  inline uchar SharpenPixel(int s, int b)
+  {
+    const int t = 3 * s - b;
+    return cv::saturate_cast<uchar>((t + ((t >> 1) & 1)) >> 1);
+  }
+
+  void SharpenScalar(const uchar *src, const uchar *blurred, uchar *dst, int count)
+  {
+    for(int i = 0; i < count; ++i)
+      dst[i] = SharpenPixel(src[i], blurred[i]);
+  }
+
+#ifdef PREPROCESS_X86
+  __attribute__((target("sse4.2")))
+  inline __m128i SharpenSse42Lanes(__m128i s, __m128i b)
+  {
+    const __m128i t = _mm_sub_epi16(_mm_add_epi16(s, _mm_slli_epi16(s, 1)), b);
+    const __m128i odd = _mm_and_si128(_mm_srai_epi16(t, 1), _mm_set1_epi16(1));
+    return _mm_srai_epi16(_mm_add_epi16(t, odd), 1);
+  }
+
+  __attribute__((target("sse4.2")))
+  void SharpenSse42(const uchar *src, const uchar *blurred, uchar *dst, int count)
+  {
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+      const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blurred + i));
+      const __m128i lo = SharpenSse42Lanes(_mm_cvtepu8_epi16(s), _mm_cvtepu8_epi16(b));
+      const __m128i hi = SharpenSse42Lanes(_mm_cvtepu8_epi16(_mm_srli_si128(s, 8)), \
+                                           _mm_cvtepu8_epi16(_mm_srli_si128(b, 8)));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    SharpenScalar(src + i, blurred + i, dst + i, count - i);
+  }
+
+  __attribute__((target("avx2")))
+  inline __m256i SharpenAvx2Lanes(__m256i s, __m256i b)
+  {
+    const __m256i t = _mm256_sub_epi16(_mm256_add_epi16(s, _mm256_slli_epi16(s, 1)), b);
+    const __m256i odd = _mm256_and_si256(_mm256_srai_epi16(t, 1), _mm256_set1_epi16(1));
+    return _mm256_srai_epi16(_mm256_add_epi16(t, odd), 1);
+  }
+
+  __attribute__((target("avx2")))
+  void SharpenAvx2(const uchar *src, const uchar *blurred, uchar *dst, int count)
+  {
+    int i = 0;
+    for(; i + 32 <= count; i += 32)
+    {
+      const __m128i * s = reinterpret_cast<const __m128i *>(src + i);
+      const __m128i * b = reinterpret_cast<const __m128i *>(blurred + i);
+      const __m256i lo = SharpenAvx2Lanes(_mm256_cvtepu8_epi16(_mm_loadu_si128(s)), \
+                                          _mm256_cvtepu8_epi16(_mm_loadu_si128(b)));
+      const __m256i hi = SharpenAvx2Lanes(_mm256_cvtepu8_epi16(_mm_loadu_si128(s + 1)), \
+                                          _mm256_cvtepu8_epi16(_mm_loadu_si128(b + 1)));
+      // packus works inside 128 bit lanes, restore the order of quarters
+      const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+    }
+    SharpenScalar(src + i, blurred + i, dst + i, count - i);
+  }
+
+  __attribute__((target("avx512f,avx512bw")))
+  void SharpenAvx512(const uchar *src, const uchar *blurred, uchar *dst, int count)
+  {
+    int i = 0;
+    const __m512i one = _mm512_set1_epi16(1);
+    const __m512i zero = _mm512_setzero_si512();
+    for(; i + 32 <= count; i += 32)
+    {
+      const __m512i s = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)));
+      const __m512i b = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(blurred + i)));
+      const __m512i t = _mm512_sub_epi16(_mm512_add_epi16(s, _mm512_slli_epi16(s, 1)), b);
+      const __m512i odd = _mm512_and_si512(_mm512_srai_epi16(t, 1), one);
+      // negative values to zero, unsigned narrowing saturates at 255
+      const __m512i r = _mm512_max_epi16(_mm512_srai_epi16(_mm512_add_epi16(t, odd), 1), zero);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm512_cvtusepi16_epi8(r));
+    }
+    SharpenScalar(src + i, blurred + i, dst + i, count - i);
+  }
+#endif
+
+  typedef void (*SharpenFunc)(const uchar *, const uchar *, uchar *, int);
+
+  struct SharpenImpl
+  {
+    SharpenFunc func;
+    const char * isa;
+  };
+
+  SharpenImpl SelectSharpen()
+  {
+#ifdef PREPROCESS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512bw"))
+      return {SharpenAvx512, "AVX-512"};
+    if(__builtin_cpu_supports("avx2"))
+      return {SharpenAvx2, "AVX2"};
+    if(__builtin_cpu_supports("sse4.2"))
+      return {SharpenSse42, "SSE4.2"};
+#endif
+    return {SharpenScalar, "scalar"};
+  }
+
+  const SharpenImpl & Impl()
+  {
+    static const SharpenImpl impl = SelectSharpen();
+    return impl;
+  }
+
+  // Same expression as ContrastInc, evaluated once per value
+  cv::Mat ContrastTable()
+  {
+    cv::Mat table(1, 256, CV_8U);
+    for(int v = 0; v < 256; ++v)
+      table.at<uchar>(v) = cv::saturate_cast<uchar>(settings::alpha * v + settings::beta);
+    return table;
+  }
+}
+
+namespace preprocess
+{
+  void Sharpen(const uchar *src, const uchar *blurred, uchar *dst, int count)
+  {
+    Impl().func(src, blurred, dst, count);
+  }
+
+  const char * SharpenIsa()
+  {
+    return Impl().isa;
+  }
+
+  void ContrastSharpenGray(const cv::Mat &src, cv::Mat &sharpened, cv::Mat &gray, Buffers &buffers, int stripRows)
+  {
+    CV_Assert((src.type() == CV_8UC3 || src.type() == CV_8UC1) && stripRows > 0);
+    static const cv::Mat contrastTable = ContrastTable();
+
+    // Rows of neighbours the unsharp mask reads, kernel size as cv::GaussianBlur takes it for 8 bit
+    const int halo = (cvRound(sharpenSigma * 3 * 2 + 1) | 1) / 2;
+    const int rows = src.rows;
+    const int rowLength = src.cols * src.channels();
+
+    cv::Mat &contrast = buffers.contrast;
+    cv::Mat &blurred = buffers.blurred;
+    cv::Mat &graySharp = buffers.graySharp;
+    contrast.create(src.size(), src.type());
+    blurred.create(std::min(stripRows, rows), src.cols, src.type());
+    // Gray page is blurred right after sharpening, no conversion
+    const bool color = src.channels() == 3;
+    if(color)
+      graySharp.create(src.size(), CV_8U);
+    const cv::Mat &blurSource = color ? graySharp : sharpened;
+    sharpened.create(src.size(), src.type());
+    gray.create(src.size(), CV_8U);
+
+    int contrastRows = 0; // rows with contrast applied
+    int grayRows = 0; // rows with final blur applied
+    for(int y = 0; y < rows; y += stripRows)
+    {
+      const int end = std::min(rows, y + stripRows);
+
+      // Contrast of the strip and of the rows below it the blur will read
+      const int contrastEnd = std::min(rows, end + halo);
+      cv::LUT(src.rowRange(contrastRows, contrastEnd), contrastTable, contrast.rowRange(contrastRows, contrastEnd));
+      contrastRows = contrastEnd;
+
+      // Unsharp mask, the view of contrast is not isolated so the filter sees the whole page
+      cv::Mat blurStrip = blurred.rowRange(0, end - y);
+      cv::GaussianBlur(contrast.rowRange(y, end), blurStrip, cv::Size(0, 0), sharpenSigma);
+      for(int r = y; r < end; ++r)
+        Sharpen(contrast.ptr<uchar>(r), blurStrip.ptr<uchar>(r - y), sharpened.ptr<uchar>(r), rowLength);
+
+      if(color)
+        cv::cvtColor(sharpened.rowRange(y, end), graySharp.rowRange(y, end), cv::COLOR_BGR2GRAY);
+
+      // Final blur lags one row behind, it needs the first row of the next strip
+      const int blurEnd = end == rows ? rows : end - settings::GausH / 2;
+      if(blurEnd > grayRows)
+      {
+        cv::Mat grayStrip = gray.rowRange(grayRows, blurEnd);
+        cv::GaussianBlur(blurSource.rowRange(grayRows, blurEnd), grayStrip, \
+                         cv::Size(settings::GausW, settings::GausH), 0, 0);
+        grayRows = blurEnd;
+      }
+    }
+  }
+}
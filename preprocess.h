@@ -0,0 +1,37 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "settings.h"
+
+/* Contrast, unsharp mask, grayscale and blur of a page in one pass.
+ * The page is processed in strips of rows so that every intermediate
+ * result is still in cache when the next step reads it. Strips are views
+ * of whole-page buffers, so the Gaussian filters read their neighbour rows
+ * instead of a border and the result equals the step-by-step chain of
+ * Segmentation (ContrastInc, SharpnessInc, GrayScale, GaussianBlur).
+ */
+namespace preprocess
+{
+  // Intermediate buffers, kept between pages to avoid reallocation
+  struct Buffers
+  {
+    cv::Mat contrast;
+    cv::Mat blurred; // one strip
+    cv::Mat graySharp; // color pages only
+  };
+
+  // sharpened - page for stamp cleaning and cells, gray - blurred grayscale for thresholding.
+  // src is BGR or already gray, sharpened has the same channels
+  void ContrastSharpenGray(const cv::Mat &src, cv::Mat &sharpened, cv::Mat &gray, Buffers &buffers, \
+                           int stripRows = settings::stripRows);
+
+  // dst = saturate(round(1.5 * src - 0.5 * blurred)), halves are rounded to even like cv::addWeighted
+  void Sharpen(const uchar *src, const uchar *blurred, uchar *dst, int count);
+
+  // Instruction set chosen for Sharpen at runtime
+  const char * SharpenIsa();
+}
+
+#endif // PREPROCESS_H
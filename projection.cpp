@@ -0,0 +1,105 @@
+#include "projection.h"
+
+#include <algorithm>
+
+void Projection::SetColumnSums(const cv::Mat &lines)
+{
+  CV_Assert(lines.type() == CV_8UC1);
+
+  m_columnSums.create(lines.rows + 1, lines.cols, CV_32S);
+  int * prev = m_columnSums.ptr<int>(0);
+  std::fill(prev, prev + lines.cols, 0);
+
+  for(int y = 0; y < lines.rows; ++y)
+  {
+    const uchar * src = lines.ptr<uchar>(y);
+    int * cur = m_columnSums.ptr<int>(y + 1);
+    for(int x = 0; x < lines.cols; ++x)
+      cur[x] = prev[x] + src[x];
+    prev = cur;
+  }
+}
+
+void Projection::VerticalLines(const cv::Rect &band, std::vector<int> &coords)
+{
+  coords.clear();
+  CV_Assert(band.x >= 0 && band.y >= 0 && band.x + band.width <= m_columnSums.cols && \
+            band.y + band.height < m_columnSums.rows);
+
+  // Sums of columns are exact in float, as the ones of cv::reduce
+  const int * top = m_columnSums.ptr<int>(band.y) + band.x;
+  const int * bottom = m_columnSums.ptr<int>(band.y + band.height) + band.x;
+  m_profile.resize(band.width);
+  for(int x = 0; x < band.width; ++x)
+    m_profile[x] = static_cast<float>(bottom[x] - top[x]);
+
+  if(m_profile.empty())
+    return;
+
+  // Band crossed by lines on most of its height has noise from text, cut it
+  const double max = *std::max_element(m_profile.begin(), m_profile.end());
+  const float threshold = (max / (band.height * 255)) * 100 > 80 ? max * 0.2 : max;
+  Runs(threshold, coords);
+}
+
+void Projection::HorizontalLines(const cv::Mat &lines, std::vector<int> &coords)
+{
+  coords.clear();
+  CV_Assert(lines.type() == CV_8UC1);
+
+  m_profile.resize(lines.rows);
+  for(int y = 0; y < lines.rows; ++y)
+  {
+    const uchar * src = lines.ptr<uchar>(y);
+    int sum = 0;
+    for(int x = 0; x < lines.cols; ++x)
+      sum += src[x];
+    m_profile[y] = static_cast<float>(sum);
+  }
+
+  if(m_profile.empty())
+    return;
+
+  const double max = *std::max_element(m_profile.begin(), m_profile.end());
+  Runs(max * 0.1, coords);
+}
+
+void Projection::Runs(float threshold, std::vector<int> &coords)
+{
+  // Comparison in its own loop is vectorized by the compiler
+  const size_t size = m_profile.size();
+  m_above.resize(size);
+  for(size_t i = 0; i < size; ++i)
+    m_above[i] = m_profile[i] > threshold;
+
+  // Get mean coordinate of white pixels groups
+  int x = 0;
+  int count = 0;
+  bool isSpace = false;
+
+  for(size_t i = 0; i < size; ++i)
+  {
+    if(!isSpace)
+    {
+      if(m_above[i])
+      {
+        isSpace = true;
+        count = 1;
+        x = i;
+      }
+    }
+    else
+    {
+      if(!m_above[i])
+      {
+        isSpace = false;
+        coords.push_back(x / count);
+      }
+      else
+      {
+        x += i;
+        count++;
+      }
+    }
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <vector>
+
+/* Projection profiles of line masks.
+ * Column prefix sums of the vertical lines mask are built once per page,
+ * so the vertical profile of any row band is the difference of two rows
+ * of them instead of a cv::reduce of the band. Lines are the centers of
+ * runs of the profile above a threshold. Buffers are kept between pages.
+ */
+class Projection
+{
+public:
+  // Column prefix sums of mask, row y holds sums of rows [0, y)
+  void SetColumnSums(const cv::Mat &lines);
+
+  // X coordinates of vertical lines inside band of the mask given to SetColumnSums
+  void VerticalLines(const cv::Rect &band, std::vector<int> &coords);
+
+  // Y coordinates of horizontal lines of mask
+  void HorizontalLines(const cv::Mat &lines, std::vector<int> &coords);
+
+  // Profile of the last query
+  const std::vector<float> & Profile() const { return m_profile; }
+
+  const cv::Mat & ColumnSums() const { return m_columnSums; }
+
+private:
+  cv::Mat m_columnSums; // CV_32S, rows + 1 of mask
+  std::vector<float> m_profile;
+  std::vector<uchar> m_above; // profile > threshold
+
+  // Centers of runs of profile above threshold, a run that reaches the end is not closed
+  void Runs(float threshold, std::vector<int> &coords);
+};
+
+#endif // PROJECTION_H
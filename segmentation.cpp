@@ -1,20 +1,73 @@
 #include "segmentation.h"
+#include "ocrcache.h"
+#include "textnormalizer.h"
+#include "csvwriter.h"
+#include "cellstore.h"
 
-Segmentation::Segmentation()
+Segmentation::Segmentation(const Job &job, int pageNum, PageWorkspace &workspace):
+  m_job(job), m_pageNum(pageNum), m_ws(workspace)
 {
 
 }
 
-cv::Mat Segmentation::ResizeAndCropImage(cv::Mat &inputImage, bool showStep)
-{  
-  cv::resize(inputImage, inputImage, inputImage.cols > inputImage.rows ? cv::Size(width, height) : cv::Size(height, width), 0, 0, cv::INTER_AREA);
-  if(showStep){cv::imshow("Resized image", inputImage); cv::waitKey(0);}
-  return inputImage.cols > inputImage.rows ? inputImage(cv::Rect(xBeg, yBeg, xEnd, yEnd)) : inputImage(cv::Rect(yBeg, xBeg, yEnd, xEnd));
+cv::Mat Segmentation::ResizeAndCropImage(const cv::Mat &inputImage, bool showStep)
+{
+  const bool landscape = inputImage.cols > inputImage.rows;
+  const cv::Size size = landscape ? cv::Size(width, height) : cv::Size(height, width);
+
+  const cv::Mat * page = &inputImage;
+  if(m_job.gray && inputImage.channels() == 3)
+  {
+    // The only pass over color pixels at full resolution
+    cv::cvtColor(inputImage, m_ws.grayPage, cv::COLOR_BGR2GRAY);
+    page = &m_ws.grayPage;
+  }
+
+  // Page rendered at the working size is only cropped
+  if(page->size() == size)
+    return (*page)(CropRect(landscape));
+
+  cv::resize(*page, m_ws.resized, size, 0, 0, cv::INTER_AREA);
+
+  if(showStep){cv::imshow("Resized image", m_ws.resized); cv::waitKey(0);}
+  return m_ws.resized(CropRect(landscape));
+}
+
+cv::Rect Segmentation::CropRect(bool landscape, int scale)
+{
+  return landscape ? cv::Rect(xBeg / scale, yBeg / scale, xEnd / scale, yEnd / scale) : \
+                     cv::Rect(yBeg / scale, xBeg / scale, yEnd / scale, xEnd / scale);
+}
+
+cv::Mat Segmentation::SourceCrop(const cv::Mat &inputImage)
+{
+  // Gray page was converted at source resolution by ResizeAndCropImage
+  const cv::Mat &page = m_job.gray && inputImage.channels() == 3 ? m_ws.grayPage : inputImage;
+
+  const bool landscape = page.cols > page.rows;
+  const double fx = static_cast<double>(page.cols) / (landscape ? width : height);
+  const double fy = static_cast<double>(page.rows) / (landscape ? height : width);
+  const cv::Rect crop = CropRect(landscape);
+
+  const cv::Rect rect(cv::Point(cvRound(crop.x * fx), cvRound(crop.y * fy)), \
+                      cv::Point(cvRound(crop.br().x * fx), cvRound(crop.br().y * fy)));
+  return page(rect & cv::Rect(0, 0, page.cols, page.rows));
+}
+
+cv::Mat Segmentation::StampThumbnail(const cv::Mat &inputImage)
+{
+  if(inputImage.channels() != 3)
+    return cv::Mat();
+
+  const bool landscape = inputImage.cols > inputImage.rows;
+  const cv::Size size = landscape ? cv::Size(width / stampThumbScale, height / stampThumbScale) : \
+                                    cv::Size(height / stampThumbScale, width / stampThumbScale);
+  cv::resize(inputImage, m_ws.thumbnail, size, 0, 0, cv::INTER_AREA);
+  return m_ws.thumbnail(CropRect(landscape, stampThumbScale));
 }
 
 void Segmentation::GrayScale(cv::Mat &inputImage, bool showStep)
 {
-  std::cout <<"Depth Image for grayscale "<< inputImage.depth() <<"Channels = "<< inputImage.channels() << std::endl;
   cv::cvtColor(inputImage, inputImage, cv::COLOR_BGR2GRAY);
   if(showStep){cv::imshow("GrayScale image", inputImage); cv::waitKey(0);}
 }
@@ -45,262 +98,251 @@ cv::Mat Segmentation::SetKernel(int morphShape, int w, int h)
   return cv::getStructuringElement(morphShape, cv::Size(w, h));
 }
 
-cv::Mat Segmentation::ErodeImage(const cv::Mat &inputImage, int morphShape, int kerW, int kerH, bool showStep)
+void Segmentation::ErodeImage(const cv::Mat &inputImage, cv::Mat &outputImage, int morphShape, int kerW, int kerH, bool showStep)
 {
-  cv::erode(inputImage, inputImage, SetKernel(morphShape, kerW, kerH));
-  if(showStep){cv::imshow("Eroded image", inputImage); cv::waitKey(0);}
-
-  return inputImage;
+  cv::erode(inputImage, outputImage, SetKernel(morphShape, kerW, kerH));
+  if(showStep){cv::imshow("Eroded image", outputImage); cv::waitKey(0);}
 }
 
-cv::Mat Segmentation::DilateImage(const cv::Mat &inputImage, int morphShape, int kerW, int kerH, bool showStep)
+void Segmentation::DilateImage(const cv::Mat &inputImage, cv::Mat &outputImage, int morphShape, int kerW, int kerH, bool showStep)
 {
-  cv::dilate(inputImage, inputImage, SetKernel(morphShape, kerW, kerH));
-  if(showStep){cv::imshow("Dilated image", inputImage); cv::waitKey(0);}
-
-  return inputImage;
+  cv::dilate(inputImage, outputImage, SetKernel(morphShape, kerW, kerH));
+  if(showStep){cv::imshow("Dilated image", outputImage); cv::waitKey(0);}
 }
 
-std::vector<int> Segmentation::CalulateProjection(const cv::Mat &lines, int method, bool showStep)
+void Segmentation::CalulateProjection(const cv::Mat &lines, std::vector<int> &coords, bool showStep)
 {
-    /*Compute projections*/
-    cv::Mat1f backProj;
-    cv::Mat1b hist;
-    cv::Mat histVisual = cv::Mat::zeros( lines.rows, lines.rows, CV_8UC3 );
-    std::vector<int> coords;
+  try
+  {
+    m_ws.projection.HorizontalLines(lines, coords);
+  }
 
-    double min;
-    double max;
-    float thresholdVal;
-    int sum;
+  catch (cv::Exception& ex)
+  {
+    std::cerr<<"Caught exception while calculate projection: "<<ex.msg << std::endl;
+  }
 
-    try
+  if(showStep)
+  {
+    const std::vector<float> &profile = m_ws.projection.Profile();
+    cv::Mat histVisual = cv::Mat::zeros( lines.rows, lines.rows, CV_8UC3 );
+    for(size_t i = 0; i < profile.size(); ++i)
     {
-      if(lines.channels() != 1)
-      {
-        throw std::domain_error("Unsupported channels count");
-      }
+      cv::Point begPoint(i, histVisual.rows);
+      cv::Point endPoint(i, histVisual.rows - profile[i]/255);
+      cv::line(histVisual, begPoint, endPoint, cv::Scalar(0, 0, 255), 2);
     }
+    cv::imshow("Histogram", histVisual);
+    cv::waitKey(0);
+  }
+}
 
-    catch(std::exception const &ex)
-    {
-      std::cerr << ex.what() << std::endl;
-    }
+std::string Segmentation::RecognizeCell(const cv::Mat &cellImage, OCR &ocr, int &confidence, bool upscale, CellType type)
+{
+  // Same bitmap gives the same text, on this page, on other pages and in earlier runs
+  uint64_t key = 0;
+  if(ocrCache)
+  {
+    std::string text;
+    key = OcrCache::Key(cellImage, m_job.lang + (upscale ? "|x2|" : "|x1|") + std::to_string(type));
+    if(OcrCache::Instance().Find(key, text, confidence))
+      return text;
+  }
+
+  // Upscale image to 2x for improve quality
+  cv::Mat curCell = cellImage;
+  if(upscale)
+    cv::pyrUp(cellImage, curCell, cv::Size(cellImage.cols*2, cellImage.rows*2));
+
+  // Recognize text on image, it is normalized once the type of its column is known
+  const std::string text = ocr.extractText(curCell, type);
+  confidence = ocr.Confidence();
+  if(ocrCache)
+    OcrCache::Instance().Store(key, text, confidence);
+  return text;
+}
+
+const TextNormalizer & Segmentation::Normalizer() const
+{
+  static const TextNormalizer defaultNormalizer;
+  return m_job.normalizer ? *m_job.normalizer : defaultNormalizer;
+}
 
-    cv::reduce(lines, backProj, method == 0 ? 0 : 1, CV_REDUCE_SUM);
+CellType Segmentation::ColumnType(const std::vector<std::string> &samples)
+{
+  // Cleaned text keeps digits and letters only, so separators of dates are spaces
+  static const std::regex number("[0-9 ]+");
+  static const std::regex date("[0-9]{1,2} [0-9]{1,2} [0-9]{2,4}");
 
-    cv::minMaxLoc(backProj, &min, &max);
+  int count = 0;
+  bool allDates = true;
+  for(const std::string &text : samples)
+  {
+    if(text.empty())
+      continue;
+    if(!std::regex_match(text, number))
+      return TextCell;
+    allDates &= std::regex_match(text, date);
+    ++count;
+  }
 
-    if(showStep)
+  if(count < typeMinSamples)
+    return TextCell;
+  return allDates ? DateCell : NumberCell;
+}
+
+void Segmentation::WriteResult(const cv::Mat &ocrImage, cv::Mat &inputImage, const TableGrid &grid)
+{
+  try
+  {
+    const std::string imageName = m_job.outName.empty() ? Converter::GetFilename(m_job.inPath) : m_job.outName;
+
+    // Table of the page, a row per grid row
+    DenseTable table;
+
+    // Occupancy of every cell is looked up in one table built for the page
+    BuildInkMap(inputImage);
+
+    // Cells with text, in row-major order of the grid
+    std::vector<GridCell> cells;
+    for(const GridCell &cell : grid.Cells())
     {
-      if(method == SET_HORIZONTAL)
+      if(InkRatio(cell.rect) < minInkRatio) // skip blank cells before any OCR work
       {
-        for(auto it = backProj.begin(); it!=backProj.end(); ++it)
-        {
-          std::cout <<"Min = "<< min/255 << " Max = " << max/255 << std::endl;
-          std::cout <<"Size of backProj = "<< backProj.cols <<" h = "<<lines.rows<< std::endl;
-
-          cv::Point begPoint((it - backProj.begin()), backProj.rows);
-          cv::Point endPoint((it - backProj.begin()), backProj.rows - *it/255);
-          std::cout<<*it/255<<std::endl;
-          cv::line(histVisual, begPoint, endPoint, cv::Scalar(0, 0, 255), 2);
-        }
-        cv::imshow("Histogram", histVisual);
-        cv::waitKey(0);
+        continue;
       }
+
+      cells.push_back(cell);
     }
 
-    /* Remove noise in histogram. White bins identify space lines, black bins identify text lines */
-    switch(method)
+    // Cell rects are mapped onto the recognized page. Source rendered at least twice as big is not
+    // upscaled, unless it came out much smaller than asked, like a scan of low native resolution
+    const double fx = static_cast<double>(ocrImage.cols) / inputImage.cols;
+    const double fy = static_cast<double>(ocrImage.rows) / inputImage.rows;
+    const bool upscale = m_job.ocrScale < 2 || std::min(fx, fy) < m_job.ocrScale * 0.75;
+    std::vector<cv::Rect> ocrRects;
+    for(const GridCell &cell : cells)
     {
-    case SET_VERTICAL:
-      thresholdVal = (max / (lines.rows * 255)) * 100 > 80 ? max * 0.2 : max;
-      sum = lines.cols;
-      break;
-    case SET_HORIZONTAL:
-      thresholdVal = max * 0.1;
-      sum = lines.rows;
-      break;
+      const cv::Rect &r = cell.rect;
+      ocrRects.push_back(cv::Rect(cv::Point(cvRound(r.x * fx), cvRound(r.y * fy)), \
+                                  cv::Point(cvRound(r.br().x * fx), cvRound(r.br().y * fy))) & \
+                         cv::Rect(0, 0, ocrImage.cols, ocrImage.rows));
     }
 
-    hist = backProj > thresholdVal;
+    // Recognized and normalized text, its confidence and column type, in the same order as cells
+    std::vector<std::string> raws(cells.size());
+    std::vector<std::string> texts(cells.size());
+    std::vector<int> confidences(cells.size(), -1);
+    std::vector<CellType> types(cells.size(), TextCell);
 
-    // Get mean coordinate of white white pixels groups
-    int x = 0;
-    int count = 0;
-    bool isSpace = false;
-
-    for (int i = 0; i <  sum; ++i)
+    auto recognize = [&](size_t begin, size_t end)
     {
-      if (!isSpace)
+      // Restricted cell read as nothing is read again by the full model
+      auto cellText = [&](size_t c, OCR &ocr)
       {
-        if (hist(i))
+        raws[c] = RecognizeCell(ocrImage(ocrRects[c]), ocr, confidences[c], upscale, types[c]);
+        texts[c] = Normalizer().Normalize(raws[c], types[c]);
+        if(texts[c].empty() && types[c] != TextCell)
         {
-          isSpace = true;
-          count = 1;
-          x = i;
+          raws[c] = RecognizeCell(ocrImage(ocrRects[c]), ocr, confidences[c], upscale);
+          texts[c] = Normalizer().Normalize(raws[c], types[c]);
         }
-      }
+      };
 
-      else
+      if(m_job.cellPool)
       {
-        if (!hist(i))
+        // Every task checks out its own engine from the pool
+        TaskGroup group(*m_job.cellPool);
+        for(size_t c = begin; c < end; ++c)
         {
-          isSpace = false;
-          coords.push_back(x / count);
+          group.Submit([&, c](int)
+          {
+            OCR ocr(m_job.lang);
+            cellText(c, ocr);
+          });
         }
-        else
+        group.Wait();
+      }
+      else
+      {
+        OCR ocr(m_job.lang);
+        for(size_t c = begin; c < end; ++c)
         {
-          x += i;
-          count++;
+          cellText(c, ocr);
         }
       }
+    };
+
+    // First rows are recognized by the full model, they give types of the columns
+    size_t sampled = 0;
+    while(sampled < cells.size() && cells[sampled].row < typeSampleRows)
+      ++sampled;
+    recognize(0, sampled);
+
+    // Rows of different structure have their own columns, so column is its index and count in row
+    std::vector<int> rowColumns(grid.Rows(), 0);
+    for(const GridCell &cell : grid.Cells())
+      rowColumns[cell.row] = std::max(rowColumns[cell.row], cell.col + 1);
+
+    // The first row is a header, it is not a sample
+    std::map<std::pair<int, int>, std::vector<std::string>> samples;
+    for(size_t c = 0; c < sampled; ++c)
+    {
+      if(cells[c].row > 0)
+        samples[{rowColumns[cells[c].row], cells[c].col}].push_back(texts[c]);
     }
 
-    return coords;
-
-}
-
-void Segmentation::SortCells(std::vector<cv::Rect> &cells, bool showStep)
-{
-  if(!cells.empty())
-  {
-    std::sort(cells.begin(), cells.end(),
-    [](const cv::Rect &l, const cv::Rect &r)
-    {
-      if(l.y == r.y)
-        return l.x < r.x;
-      else
-        return l.y < r.y;
-    });
+    std::map<std::pair<int, int>, CellType> columnTypes;
+    for(const auto &column : samples)
+      columnTypes[column.first] = ColumnType(column.second);
 
-    if(showStep)
+    for(size_t c = 0; c < cells.size(); ++c)
     {
-      std::cout<<std::endl;
-      for(auto &rect:cells)
-      {
-        std::cout<<rect<<std::endl;
-      }
-      std::cout<<std::endl;
+      auto it = columnTypes.find({rowColumns[cells[c].row], cells[c].col});
+      if(it == columnTypes.end() || (c < sampled && cells[c].row == 0))
+        continue;
+      types[c] = it->second;
+
+      // Samples were read by the full model, they keep the separators of their column as well
+      if(c < sampled)
+        texts[c] = Normalizer().Normalize(raws[c], types[c]);
     }
-  }
-}
+    recognize(sampled, cells.size());
 
-std::vector<std::vector<cv::Rect>> Segmentation::GroupCells(const std::vector<cv::Rect> &rects, bool showStep)
-{
-  std::vector<std::vector<cv::Rect>> result;
-  std::vector<cv::Rect> group;
-  cv::Rect prev = {0, 0, 0, 0};
+    // Shape of the table is known from the grid, no cell grows it
+    if(!rowColumns.empty())
+      table.Reserve(rowColumns.size(), *std::max_element(rowColumns.begin(), rowColumns.end()));
 
-  for(auto it = rects.begin(); it != rects.end(); it++)
-  {
-    if(!prev.y || std::abs( it->y - prev.y ) <= cellGap)
+    if(m_job.cellCount)
+      *m_job.cellCount += cells.size();
+
+    // Cells of the page with their coordinates go to the columnar file of the document
+    if(m_job.cellStore)
     {
-      group.push_back(*it);
+      std::vector<CellStore::Cell> stored;
+      for(size_t c = 0; c < cells.size(); ++c)
+        stored.push_back(CellStore::Cell{cells[c].row, cells[c].col, cells[c].rect, confidences[c], texts[c]});
+      m_job.cellStore->AddPage(m_pageNum, std::move(stored));
     }
-    else
+
+    // Fill table in row-major order, so the result does not depend on the order of recognition
+    for(size_t c = 0; c < cells.size(); ++c)
     {
-      result.emplace_back(group);
-      group = {*it};
+      table.setCell(cells[c].col, cells[c].row, std::move(texts[c]));
     }
-    prev = *it;
-  }
 
-  if(!group.empty()){result.emplace_back(group);}
-
-  if(showStep)
-  {
-    for(auto i = result.begin(); i != result.end(); i++)
+    const std::string csvName = m_job.outPath + "/" + imageName + "_" + std::to_string(m_pageNum) + ".csv";
+    if(m_job.csvWriter)
     {
-      for(auto j = i->begin(); j < i->end(); j++)
-      {
-        std::cout<<*j<<' ';
-      }
-      std::cout<<std::endl;
+      m_job.csvWriter->Write(csvName, table); // Save as csv table in background
     }
-  }
-
-  return result;
-
-}
-
-void Segmentation::WriteResult(cv::Mat &srcImage, cv::Mat &inputImage, const std::vector<std::vector<cv::Rect>> &groupedRect)
-{
-  try
-  {
-    // Initialize Tesseract-API
-    OCR * ocrInit = new OCR();
-
-    const std::string imageName = Converter::GetFilename(inPath);
-
-    // Index of page
-    static int pageNum = 0;
-
-    // Initialize csv writer
-    ccsv::cellCsv csvWriter;
-
-    // UTF-8 <-> UTF-16 converter
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> UTF8_UTF_16_CONVERTER;
-
-    // Cell index
-    int cellIdx = 0;
-
-    // Write png image without compression
-    const std::vector<int> compressParams = {CV_IMWRITE_PNG_COMPRESSION, 0};
-
-    // Set locale
-    std::locale wcoutLoc{std::wcout.getloc(), new std::codecvt_utf8<wchar_t>{}};
-    std::wcout.imbue(wcoutLoc);
-
-    for(auto i = groupedRect.begin(); i != groupedRect.end(); i++)
+    else
     {
-      int raw = i - groupedRect.begin(); // Iterator to index
-      for(auto j = i->begin(); j != i->end(); j++, cellIdx++)
-      {
-        int col = j - i->begin(); // convert iterator to index
-
-        if(CountWhite(inputImage(*j)) == 0) // skip full white cells
-        {
-          continue;
-        }
-
-        else
-        {
-          // Upscale image to 2x for improve quality
-          cv::Mat curCell;
-          cv::pyrUp(srcImage(*j), curCell, cv::Size(srcImage(*j).cols*2, srcImage(*j).rows*2));
-
-          // Recognize text on image
-          std::wstring textCell = ocrInit->extractText(curCell);
-
-          // Clean string from special characters
-          textCell = std::regex_replace(textCell, std::wregex(L"[^0-9а-яА-Я]+"),  L" ");
-
-          // Clean string from ending spaces
-          textCell = [] (const std::wstring& str) -> std::wstring
-          {
-            size_t first = str.find_first_not_of(' ');
-            if (std::wstring::npos == first)
-            {
-              return str;
-            }
-            size_t last = str.find_last_not_of(' ');
-            return str.substr(first, (last - first + 1));
-          }(textCell);
-
-          csvWriter.setCell(col, raw, UTF8_UTF_16_CONVERTER.to_bytes(textCell));
-          /*std::wcout << textCell<< std::endl;*/
-        }
-      }
+      std::string text;
+      CsvWriter::Format(table, m_job.csvFormat, text);
+      if(!CsvWriter::WriteFile(csvName, text))
+        std::cerr << RED << "Can't write " << csvName << RESET << std::endl;
     }
-
-    delete ocrInit; // Release memory
-
-    ocrInit = nullptr;
-
-    csvWriter.dump(outPath + "/" + imageName + "_" + std::to_string(pageNum) + ".csv"); // Save as csv table
-
-    pageNum++; // Move to next page
   }
 
   catch (std::exception& ex)
@@ -309,115 +351,120 @@ void Segmentation::WriteResult(cv::Mat &srcImage, cv::Mat &inputImage, const std
   }
 }
 
-std::vector<std::vector<cv::Rect>> Segmentation::DrawBorders(cv::Mat &srcImage, cv::Mat &inputImage, const cv::RotatedRect &blobBox, \
-                                                             const std::vector<int> yCoords, const cv::Mat &mask, bool showStep)
+void Segmentation::DrawBorders(cv::Mat &srcImage, cv::Mat &inputImage, cv::Mat &ocrImage, const cv::RotatedRect &blobBox, \
+                               const std::vector<int> &yCoords, const cv::Mat &mask, TableGrid &grid, bool showStep)
 {
-  std::vector<std::vector<cv::Point>> contours; // Array with counters that extracted from image
-  std::vector<cv::Rect> boundRectArray; // Array with bounded rects
-  std::vector<std::vector<cv::Rect>> groupedRect; // Array with grouped bounded rects
+  grid.Clear();
 
   try
   {
-    // Empty image for pattern
-    cv::Mat patternImage = cv::Mat::zeros(inputImage.rows, inputImage.cols, CV_8UC1);
+    // Vertical profile of every row band is taken from column sums of the whole mask
+    m_ws.projection.SetColumnSums(mask);
+    std::vector<int> xCoords;
+    std::vector<int> xs; // borders of cells in the band
 
-    for(auto yIt = yCoords.begin(); yIt != yCoords.end() - 1; ++yIt)
+    for(size_t i = 0; i + 1 < yCoords.size(); ++i)
     {
-      if(*(std::next(yIt)) - *yIt >= lineGap)
+      if(yCoords[i + 1] - yCoords[i] >= lineGap)
       {
-        // Draw horizontal lines
-        cv::Rect RectROI(blobBox.boundingRect().tl().x - leftGap, *yIt, inputImage.cols - \
-                        (inputImage.cols - blobBox.boundingRect().width) + rightGap, *(std::next(yIt)) - *yIt);
-
-        cv::rectangle(inputImage, RectROI , colHor, sizeHor);
-        cv::rectangle(patternImage, RectROI , WHITE_CV, sizeHor);
-        cv::rectangle(srcImage, RectROI , WHITE_CV, sizeHor);
+        // Band between horizontal lines
+        cv::Rect RectROI(blobBox.boundingRect().tl().x - leftGap, yCoords[i], inputImage.cols - \
+                        (inputImage.cols - blobBox.boundingRect().width) + rightGap, yCoords[i + 1] - yCoords[i]);
 
-        cv::Mat matROI = mask(RectROI);
-        std::vector<int> xCoords = CalulateProjection(matROI, SET_VERTICAL, 0);
+        m_ws.projection.VerticalLines(RectROI, xCoords);
 
+        xs.clear();
+        xs.push_back(RectROI.x);
         for(auto xIt = xCoords.begin(); xIt != xCoords.end(); ++xIt)
         {
-          /*Draw vertical lines*/
-          cv::line(inputImage(RectROI), cv::Point(*xIt, 0), cv::Point(*xIt, mask(RectROI).rows), colVer, sizeVer);
-          cv::line(patternImage(RectROI), cv::Point(*xIt, 0), cv::Point(*xIt, mask(RectROI).rows), WHITE_CV, sizeVer);
-          cv::line(srcImage(RectROI), cv::Point(*xIt, 0), cv::Point(*xIt, mask(RectROI).rows), WHITE_CV, sizeVer);
+          xs.push_back(RectROI.x + *xIt);
         }
-        
-        /* cv::imshow("ROI: " + std::to_string(it - yCoords.begin()), inputImage(RectROI)) */
+        xs.push_back(RectROI.x + RectROI.width - 1); // rectangle is drawn through its last pixel
 
+        // Cells are the areas between the lines of band
+        grid.AddRow(RectROI.y, RectROI.y + RectROI.height - 1, xs, sizeHor, sizeVer);
+        DrawBand(srcImage, inputImage, ocrImage, grid.Bands().back());
       }
     }
 
-    cv::findContours(patternImage, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
-
-    // Convert contours to bounding rects
-    std::for_each(contours.begin(), contours.end(), [&boundRectArray] (std::vector<cv::Point>& ctr)
-    {
-      cv::Rect boundRect = cv::boundingRect(ctr);
-      boundRectArray.emplace_back(boundRect);
-    });
-
-    // Sort bound rects from top-left to bottom-right
-    SortCells(boundRectArray, 0);
-
-    // Erase biggest external rectangle
-    boundRectArray.erase(boundRectArray.begin());
-
-    // Skip empty cells
-    for(auto rect = boundRectArray.end(); rect != boundRectArray.begin(); --rect)
-    {
-      if(rect->width <= 6 || rect->height <= 3)
-      {
-        boundRectArray.erase(--rect);
-      }
-    }
-
-    // Clustering rectangles based on 'Y' position
-    groupedRect = GroupCells(boundRectArray, 0);
-
     if(showStep)
     {
-      cv::imshow("Pattern", patternImage); cv::waitKey(0);
+      for(const GridCell &cell : grid.Cells())
+        std::cout << cell.row << ' ' << cell.col << ' ' << cell.rect << std::endl;
+      cv::imshow("Borders", inputImage); cv::waitKey(0);
     }
   }
 
   catch (cv::Exception& ex)
   {
     std::cerr<<"Caught exception while drawBorders: "<<ex.msg << std::endl;
+    grid.Clear();
   }
-
-  return groupedRect;
 }
 
-int Segmentation::CountWhite(const cv::Mat &inputImage)
+void Segmentation::DrawBand(cv::Mat &srcImage, cv::Mat &inputImage, cv::Mat &ocrImage, const GridBand &band)
 {
-  double imgSquare = inputImage.cols * inputImage.rows;
-  int countPixels = 0;
+  const cv::Rect rect(band.xs.front(), band.top, band.xs.back() - band.xs.front() + 1, band.bottom - band.top + 1);
 
-  for( int y = 0; y < inputImage.rows; y++ )
+  // Draw horizontal lines
+  cv::rectangle(inputImage, rect, colHor, sizeHor);
+  cv::rectangle(srcImage, rect, WHITE_CV, sizeHor);
+
+  /*Draw vertical lines*/
+  for(size_t i = 1; i + 1 < band.xs.size(); ++i)
   {
-    for( int x = 0; x < inputImage.cols; x++ )
-    {
-      cv::Vec3b bgrPixel = inputImage.at<cv::Vec3b>(y, x);
-      if(bgrPixel[0] > 252 && bgrPixel[1] > 252 && bgrPixel[2] > 252)
-      {countPixels++;}
+    const int x = band.xs[i] - rect.x;
+    cv::line(inputImage(rect), cv::Point(x, 0), cv::Point(x, rect.height), colVer, sizeVer);
+    cv::line(srcImage(rect), cv::Point(x, 0), cv::Point(x, rect.height), WHITE_CV, sizeVer);
+  }
 
-    }
+  // Cells are cut from the bigger source, its lines are whited out as well
+  if(ocrImage.data != srcImage.data)
+  {
+    const double fx = static_cast<double>(ocrImage.cols) / srcImage.cols;
+    const double fy = static_cast<double>(ocrImage.rows) / srcImage.rows;
+    auto scaled = [fx, fy](int x, int y) { return cv::Point(cvRound(x * fx), cvRound(y * fy)); };
+
+    cv::rectangle(ocrImage, scaled(rect.x, rect.y), scaled(rect.br().x - 1, rect.br().y - 1), WHITE_CV, \
+                  cvCeil(sizeHor * std::max(fx, fy)));
+    for(size_t i = 1; i + 1 < band.xs.size(); ++i)
+      cv::line(ocrImage, scaled(band.xs[i], band.top), scaled(band.xs[i], band.bottom), WHITE_CV, cvCeil(sizeVer * fx));
   }
+}
 
-  double pct = 100 - countPixels/imgSquare * 100;
-  return pct;
+void Segmentation::BuildInkMap(const cv::Mat &inputImage)
+{
+  // Ink is any pixel with a channel not brighter than 252
+  if(inputImage.channels() == 1)
+    cv::compare(inputImage, 252, m_ws.ink, cv::CMP_LE);
+  else
+  {
+    cv::inRange(inputImage, cv::Scalar(253, 253, 253), cv::Scalar(255, 255, 255), m_ws.ink);
+    cv::bitwise_not(m_ws.ink, m_ws.ink);
+  }
 
+  // Summed-area table of 0 / 255 ink values, fits 32 bit for the page
+  cv::integral(m_ws.ink, m_ws.inkSum, CV_32S);
 }
 
+double Segmentation::InkRatio(const cv::Rect &cell)
+{
+  const cv::Rect rect = cell & cv::Rect(0, 0, m_ws.ink.cols, m_ws.ink.rows);
+  if(rect.area() == 0)
+    return 0;
+
+  const cv::Mat1i sum = m_ws.inkSum;
+  const double ink = sum(rect.y + rect.height, rect.x + rect.width) - sum(rect.y, rect.x + rect.width) \
+                     - sum(rect.y + rect.height, rect.x) + sum(rect.y, rect.x);
+  return ink / 255 / rect.area();
+}
 
-void Segmentation::FindBiggestBlob(cv::Mat inputImage, cv::Mat &biggestBlob, int morphShape, int kerW, int kerH, bool showStep)
+void Segmentation::FindBiggestBlob(const cv::Mat &inputImage, cv::Mat &biggestBlob, BlobBuffers &buffers, int morphShape, int kerW, int kerH, bool showStep)
 {
   try
   {
     int maxArea = -1;
-    cv::Point maxPt; // Declare point that belongs to biggest blob
+    int maxLabel = 0; // Label of biggest blob
 
     if(inputImage.channels() != 1)
     {
@@ -425,23 +472,19 @@ void Segmentation::FindBiggestBlob(cv::Mat inputImage, cv::Mat &biggestBlob, int
     }
 
     // Dilate inputImage with default kernel
-    DilateImage(inputImage, morphShape, kerW, kerH, 0);
+    DilateImage(inputImage, buffers.dilated, morphShape, kerW, kerH, 0);
+
+    // Label all blobs in one pass, 4-connected as flood fill. Labels follow the raster order
+    // of the first pixel of blob, so of equal blobs the first one wins as before
+    const int count = cv::connectedComponentsWithStats(buffers.dilated, buffers.labels, buffers.stats, buffers.centroids, 4, CV_32S);
 
-    // Find biggest blob
-    for(int y = 0; y < inputImage.size().height; y++)
+    for(int label = 1; label < count; ++label) // label 0 is background
     {
-      uchar *row = inputImage.ptr(y);
-      for(int x = 0; x < inputImage.size().width; x++)
+      const int area = buffers.stats.at<int>(label, cv::CC_STAT_AREA);
+      if(area > maxArea)
       {
-        if(row[x] >= 128)
-        {
-          int area = cv::floodFill(inputImage, cv::Point(x, y), CV_RGB(0, 0, 64));
-          if(area > maxArea)
-          {
-            maxPt = cv::Point(x,y);
-            maxArea = area;
-          }
-        }
+        maxLabel = label;
+        maxArea = area;
       }
     }
 
@@ -451,36 +494,93 @@ void Segmentation::FindBiggestBlob(cv::Mat inputImage, cv::Mat &biggestBlob, int
     }
 
     // Turn the other blobs black
-    cv::floodFill(inputImage, maxPt, CV_RGB(255, 255, 255));
-    biggestBlob = inputImage < 255;
-    cv::bitwise_not(biggestBlob, biggestBlob);
+    cv::compare(buffers.labels, maxLabel, biggestBlob, cv::CMP_EQ);
   }
 
   catch(std::exception const &ex)
   {
+    biggestBlob.release(); // no blob on this page, not the one of previous page
     std::cerr << ex.what() << std::endl;
   }
 
   if(showStep){cv::imshow("Biggest blob", biggestBlob); cv::waitKey(0);}
 }
 
-void Segmentation::CleanStamp(cv::Mat &inputImage, bool showStep)
+void Segmentation::FindBiggestBlobFlood(cv::Mat inputImage, cv::Mat &biggestBlob, int morphShape, int kerW, int kerH)
 {
-  cv::Mat hsv, mask, biggestBlob;
-  cv::cvtColor(inputImage, hsv, cv::COLOR_BGR2HSV);
+  int maxArea = -1;
+  cv::Point maxPt; // Declare point that belongs to biggest blob
+
+  // Dilate inputImage with default kernel
+  DilateImage(inputImage, inputImage, morphShape, kerW, kerH, 0);
+
+  // Find biggest blob
+  for(int y = 0; y < inputImage.size().height; y++)
+  {
+    uchar *row = inputImage.ptr(y);
+    for(int x = 0; x < inputImage.size().width; x++)
+    {
+      if(row[x] >= 128)
+      {
+        int area = cv::floodFill(inputImage, cv::Point(x, y), CV_RGB(0, 0, 64));
+        if(area > maxArea)
+        {
+          maxPt = cv::Point(x,y);
+          maxArea = area;
+        }
+      }
+    }
+  }
+
+  if(maxArea == -1)
+  {
+    biggestBlob.release();
+    return;
+  }
+
+  // Turn the other blobs black
+  cv::floodFill(inputImage, maxPt, CV_RGB(255, 255, 255));
+  biggestBlob = inputImage < 255;
+  cv::bitwise_not(biggestBlob, biggestBlob);
+}
+
+void Segmentation::CleanStamp(cv::Mat &inputImage, const cv::Mat &colorImage, bool showStep)
+{
+  if(colorImage.empty())
+    return;
+
+  // Kernel and area are scaled when the stamp is searched on a thumbnail
+  const double scale = static_cast<double>(inputImage.cols) / colorImage.cols;
+  const int kernelSize = std::max(3, static_cast<int>(11 / scale) | 1);
+  const double stampArea = minStampArea / (scale * scale);
+
+  cv::Mat &hsv = m_ws.hsv;
+  cv::Mat &mask = m_ws.stampMask;
+  cv::Mat &biggestBlob = m_ws.stampBlob;
+  cv::cvtColor(colorImage, hsv, cv::COLOR_BGR2HSV);
   cv::inRange(hsv, cv::Scalar(100, 50, 50), cv::Scalar(135, 255, 255), mask);
 
   if(cv::countNonZero(mask) > 0)
   {
-    FindBiggestBlob(mask, biggestBlob, cv::MORPH_ELLIPSE, 11, 11, 0);
+    FindBiggestBlob(mask, biggestBlob, m_ws.stampScratch, cv::MORPH_ELLIPSE, kernelSize, kernelSize, 0);
   }
 
   else
     return;
 
-  if(cv::countNonZero(biggestBlob) > minStampArea)
+  if(cv::countNonZero(biggestBlob) > stampArea)
   {
-    inputImage.setTo(cv::Scalar(255,255,255), biggestBlob);
+    if(colorImage.size() != inputImage.size())
+    {
+      // One thumbnail pixel more around the blob covers the edges lost by downscaling
+      DilateImage(biggestBlob, biggestBlob, cv::MORPH_RECT, 3, 3);
+      cv::resize(biggestBlob, m_ws.stampPage, inputImage.size(), 0, 0, cv::INTER_NEAREST);
+      inputImage.setTo(cv::Scalar(255,255,255), m_ws.stampPage);
+    }
+    else
+    {
+      inputImage.setTo(cv::Scalar(255,255,255), biggestBlob);
+    }
     if(showStep){cv::imshow("Clean image from stamp", inputImage); cv::waitKey(0);}
   }
 
@@ -524,36 +624,63 @@ void Segmentation::RectAroundBiggestBlob(const cv::Mat &biggestBlob, cv::Rotated
 
 }
 
-void Segmentation::DeskewImage(cv::Mat &inputImage, const cv::Mat &mask, bool showStep)
+double Segmentation::SkewAngle(const cv::Mat &mask, bool showStep)
 {
+  double meanAngle = 0.0;
+
   try
   {
     std::vector<cv::Vec4i> lines;
-    cv::Size size = inputImage.size();
-    cv::HoughLinesP(mask, lines, 1, CV_PI/360, 100, size.width / 6.f, 5 );
-
-    double meanAngle = 0.0;
+    cv::HoughLinesP(mask, lines, 1, CV_PI/360, 100, mask.cols / 6.f, 5 );
 
     if(!lines.empty())
     {
-      int i = 0;
-      for (auto it = lines.begin(); it != lines.end(); ++it, ++i)
+      for (auto it = lines.begin(); it != lines.end(); ++it)
       {
-
-      meanAngle += atan2((double)lines[i][3] - lines[i][1],\
-          (double)lines[i][2] - lines[i][0]);
+        meanAngle += atan2((double)(*it)[3] - (*it)[1], (double)(*it)[2] - (*it)[0]);
       }
       meanAngle /= lines.size(); // mean angle, in radians.
     }
 
-    cv::Mat rotMat = cv::getRotationMatrix2D(cv::Point2f(size.width / 2.f, size.height / 2.f), meanAngle * 180 / CV_PI, 1.0);
-    cv::warpAffine(inputImage, inputImage, rotMat, inputImage.size(), cv::INTER_CUBIC);
-
     if(showStep)
     {
       std::cout <<"Angle = "<< meanAngle * 180 / CV_PI << std::endl;
       std::cout <<"The number of all detected lines is "<< lines.size() << std::endl;
+    }
+  }
+
+  catch (cv::Exception& ex){std::cerr<<"Caught exception while deskewImage: "<<ex.msg << std::endl;}
+
+  return meanAngle * 180 / CV_PI;
+}
+
+bool Segmentation::SkewVisible(double angle, const cv::Size &size)
+{
+  // Corners are the farthest from the center of rotation
+  const double radius = std::sqrt(size.width * size.width + size.height * size.height) / 2;
+  return radius * 2 * std::sin(std::abs(angle) * CV_PI / 360) > skewTolerance;
+}
 
+void Segmentation::DeskewImage(cv::Mat &inputImage, double angle, bool showStep)
+{
+  try
+  {
+    cv::Size size = inputImage.size();
+    cv::Mat rotMat = cv::getRotationMatrix2D(cv::Point2f(size.width / 2.f, size.height / 2.f), angle, 1.0);
+
+    // Page at source resolution has its own scratch, so the working ones keep their size
+    cv::Mat &warped = inputImage.size() != m_ws.gray.size() ? m_ws.warpSource : \
+                      inputImage.channels() == 1 ? m_ws.warpGray : m_ws.warpColor;
+    cv::warpAffine(inputImage, warped, rotMat, size, cv::INTER_CUBIC);
+
+    // Whole workspace buffers trade places with the scratch one, views of a page are copied back
+    if(inputImage.isSubmatrix())
+      warped.copyTo(inputImage);
+    else
+      cv::swap(inputImage, warped);
+
+    if(showStep)
+    {
       cv::imshow("Deskew", inputImage);
       cv::waitKey(0);
     }
@@ -588,6 +715,64 @@ void Segmentation::SharpnessInc(const cv::Mat &inputImage, cv::Mat &outputImage,
   if(showStep){cv::imshow("Sharpness image", outputImage); cv::waitKey(0);}
 }
 
+void Segmentation::BenchPreProcess(int iterations)
+{
+  if(m_job.gray)
+  {
+    std::cerr << "Benchmark compares color preprocessing, run it without gray mode" << std::endl;
+    return;
+  }
+
+  cv::Mat inputImage = GetImage();
+  cv::Mat croppedImage = ResizeAndCropImage(inputImage);
+
+  cv::Mat contrastImage, sharpnessImage, imProc;
+  double chainMs = 0, fusedMs = 0;
+
+  for(int i = 0; i < iterations; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    ContrastInc(croppedImage, contrastImage);
+    SharpnessInc(contrastImage, sharpnessImage);
+    imProc = sharpnessImage.clone();
+    GrayScale(imProc);
+    GaussianBlur(imProc, GausW, GausH);
+    auto middle = std::chrono::steady_clock::now();
+    preprocess::ContrastSharpenGray(croppedImage, m_ws.sharpness, m_ws.gray, m_ws.preprocess);
+    auto end = std::chrono::steady_clock::now();
+
+    chainMs += std::chrono::duration<double, std::milli>(middle - start).count();
+    fusedMs += std::chrono::duration<double, std::milli>(end - middle).count();
+  }
+
+  std::cout << "Page " << m_pageNum << ": step by step " << chainMs / iterations << " ms, fused (" \
+            << preprocess::SharpenIsa() << ") " << fusedMs / iterations << " ms, speedup " \
+            << chainMs / fusedMs << "x, max difference: sharpness " \
+            << cv::norm(sharpnessImage, m_ws.sharpness, cv::NORM_INF) << ", gray " \
+            << cv::norm(imProc, m_ws.gray, cv::NORM_INF) << std::endl;
+
+  // Biggest blob of the thresholded page, as preProcess searches it
+  AdaptiveThreshold(imProc);
+  cv::Mat floodBlob;
+  double floodMs = 0, labelMs = 0;
+
+  for(int i = 0; i < iterations; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    FindBiggestBlobFlood(imProc.clone(), floodBlob, cv::MORPH_RECT, 3, 3);
+    auto middle = std::chrono::steady_clock::now();
+    FindBiggestBlob(imProc, m_ws.blob, m_ws.blobScratch, cv::MORPH_RECT, 3, 3);
+    auto end = std::chrono::steady_clock::now();
+
+    floodMs += std::chrono::duration<double, std::milli>(middle - start).count();
+    labelMs += std::chrono::duration<double, std::milli>(end - middle).count();
+  }
+
+  std::cout << "Page " << m_pageNum << ": biggest blob by flood fill " << floodMs / iterations << " ms, " \
+            << "by connected components " << labelMs / iterations << " ms, speedup " << floodMs / labelMs << "x, " \
+            << "masks " << (cv::norm(floodBlob, m_ws.blob, cv::NORM_INF) == 0 ? "equal" : "differ") << std::endl;
+}
+
 void Segmentation::DrawRect(cv::Mat inputImage, const cv::RotatedRect &rotRect)
 {
   cv::Point2f verticesRect[4];
@@ -5,20 +5,25 @@
 #include "opencv2/imgproc/imgproc.hpp"
 
 #include "settings.h"
-#include "cellCsv.hpp"
+#include "job.h"
+#include "densetable.h"
 #include "ocr.h"
+#include "preprocess.h"
+#include "pageworkspace.h"
+#include "layoutcache.h"
 
 #include <regex>
-#include <codecvt>
-#include <locale>
 
 #include <iostream>
 #include <iomanip>
 
 #include "converter.h"
+#include "threadpool.h"
 
 #include <iostream>
+#include <chrono>
 #include <string>
+#include <map>
 #include <vector>
 
 using namespace settings;
@@ -26,86 +31,153 @@ using namespace settings;
 class Segmentation
 {
 public:
-  Segmentation();
+  Segmentation(const Job &job, int pageNum, PageWorkspace &workspace);
+  virtual ~Segmentation() {}
 
   void preProcess()
   {
-    cv::Mat blobBox;
-    cv::RotatedRect rotRect;
+    m_ws.BeginPage();
 
     cv::Mat inputImage = GetImage();
 
-    cv::Mat croppedImage = ResizeAndCropImage(inputImage);
+    // Gray pages keep color only in a small thumbnail for stamp detection
+    cv::Mat colorImage = m_job.gray ? StampThumbnail(inputImage) : cv::Mat();
 
-    cv::Mat contrastImage;
-    cv::Mat sharpnessImage;
+    cv::Mat croppedImage = ResizeAndCropImage(inputImage);
 
-    std::vector<std::vector<cv::Rect>> groupedBoundingRects;
+    // Cells are recognized from the page at source resolution, when it is bigger than the working one
+    cv::Mat ocrImage = m_job.ocrScale > 1 ? SourceCrop(inputImage) : croppedImage;
 
-    ContrastInc(croppedImage, contrastImage);
-    SharpnessInc(contrastImage, sharpnessImage);
+    // Full-size buffers of the worker, reused from page to page
+    cv::Mat &sharpnessImage = m_ws.sharpness;
+    cv::Mat &imProc = m_ws.gray;
 
-    cv::Mat imProc = sharpnessImage.clone();
+    // Contrast, sharpness, grayscale and blur in one pass over the page
+    preprocess::ContrastSharpenGray(croppedImage, sharpnessImage, imProc, m_ws.preprocess);
 
-    CleanStamp(sharpnessImage);
+    CleanStamp(sharpnessImage, m_job.gray ? colorImage : sharpnessImage);
 
-    GrayScale(imProc);
-    GaussianBlur(imProc, GausW, GausH);
     AdaptiveThreshold(imProc);
 
-    cv::Mat horLines, verLines;
-    horLines = ErodeImage(imProc.clone(), cv::MORPH_RECT, 27, 1); //27, 1
+    // Skew is measured once on horizontal lines
+    ErodeImage(imProc, m_ws.horLines, cv::MORPH_RECT, 27, 1); //27, 1
+    const double skewAngle = SkewAngle(m_ws.horLines);
+    const bool skewed = SkewVisible(skewAngle, m_ws.horLines.size());
+
+    // Page of a known form: grid comes from the template, line detection is skipped.
+    // Templates are deskewed, a skewed page is not matched against them
+    if(m_job.layouts && !m_job.redetect && !skewed && LayoutCache::Instance().Match(imProc, m_ws.grid))
+    {
+      for(const GridBand &band : m_ws.grid.Bands())
+        DrawBand(croppedImage, sharpnessImage, ocrImage, band);
+    }
+    else
+    {
+      DetectGrid(croppedImage, sharpnessImage, imProc, ocrImage, skewed ? skewAngle : 0);
+      if(m_job.layouts)
+        LayoutCache::Instance().Store(m_ws.grid, imProc.size());
+    }
+
+    WriteResult(ocrImage, sharpnessImage, m_ws.grid);
+
+    m_ws.EndPage();
+  }
 
-    verLines = ErodeImage(imProc.clone(), cv::MORPH_RECT, 1, 38); //1, 20
-    verLines = DilateImage(verLines, cv::MORPH_RECT, 2, 32); //2, 17
+  // Compare time and result of step-by-step preprocessing with the fused one
+  void BenchPreProcess(int iterations);
 
-    DeskewImage(sharpnessImage, horLines);
-    DeskewImage(imProc, horLines);
-    DeskewImage(verLines, horLines);
-    DeskewImage(croppedImage, horLines);
-    DeskewImage(horLines, horLines);
+private:
+  const Job &m_job;
+  const int m_pageNum;
+  PageWorkspace &m_ws;
 
-    FindBiggestBlob(imProc.clone(), blobBox, cv::MORPH_RECT, 3, 3);
-    RectAroundBiggestBlob(blobBox, rotRect);
+  // Find lines of thresholded page, whose horizontal lines are in the workspace already,
+  // deskew all images by skewAngle, 0 for a straight page, and build the grid
+  void DetectGrid(cv::Mat &croppedImage, cv::Mat &sharpnessImage, cv::Mat &imProc, cv::Mat &ocrImage, double skewAngle)
+  {
+    cv::RotatedRect rotRect;
+    cv::Mat &horLines = m_ws.horLines;
+    cv::Mat &verLines = m_ws.verLines;
+
+    ErodeImage(imProc, verLines, cv::MORPH_RECT, 1, 38); //1, 20
+    DilateImage(verLines, verLines, cv::MORPH_RECT, 2, 32); //2, 17
+
+    // Straight pages are not warped at all
+    if(skewAngle != 0)
+    {
+      DeskewImage(sharpnessImage, skewAngle);
+      DeskewImage(imProc, skewAngle);
+      DeskewImage(verLines, skewAngle);
+      DeskewImage(croppedImage, skewAngle);
+      DeskewImage(horLines, skewAngle);
+      if(ocrImage.data != croppedImage.data)
+        DeskewImage(ocrImage, skewAngle);
+    }
+
+    FindBiggestBlob(imProc, m_ws.blob, m_ws.blobScratch, cv::MORPH_RECT, 3, 3);
+    RectAroundBiggestBlob(m_ws.blob, rotRect);
 
     // Define array for y - coordinates of horizontal lines
-    std::vector<int> yCoords = CalulateProjection(horLines, SET_HORIZONTAL);
+    std::vector<int> yCoords;
+    CalulateProjection(horLines, yCoords);
 
-    groupedBoundingRects = DrawBorders(croppedImage, sharpnessImage, rotRect, yCoords, verLines);
-    WriteResult(croppedImage, sharpnessImage, groupedBoundingRects);
+    DrawBorders(croppedImage, sharpnessImage, ocrImage, rotRect, yCoords, verLines, m_ws.grid);
   }
 
-private:
   virtual cv::Mat GetImage() = 0;
 
-  cv::Mat ResizeAndCropImage(cv::Mat &inputImage, bool showStep = false);
+  cv::Mat ResizeAndCropImage(const cv::Mat &inputImage, bool showStep = false);
+  // Crop rect of page resized to width x height, scaled down by scale
+  cv::Rect CropRect(bool landscape, int scale = 1);
+  // Crop of page at its own resolution, gray in gray mode
+  cv::Mat SourceCrop(const cv::Mat &inputImage);
+  // Cropped color page downscaled by stampThumbScale, empty for gray input
+  cv::Mat StampThumbnail(const cv::Mat &inputImage);
   void GrayScale(cv::Mat &inputImage, bool showStep = false);
   void GaussianBlur(cv::Mat &inputImage, int W, int H,  bool showStep = false);
   void AdaptiveThreshold(cv::Mat &inputImage, bool showStep = false);
 
-  std::vector<int> CalulateProjection(const cv::Mat &lines, int method, bool showStep = false);
-  std::vector<std::vector<cv::Rect>> DrawBorders(cv::Mat &srcImage, cv::Mat &inputImage, \
-                                                 const cv::RotatedRect &blobBox, const std::vector<int> yCoords, const cv::Mat &mask, bool showStep = false);
+  // Y coordinates of horizontal lines
+  void CalulateProjection(const cv::Mat &lines, std::vector<int> &coords, bool showStep = false);
+  // Draw detected lines and build the grid of cells between them
+  void DrawBorders(cv::Mat &srcImage, cv::Mat &inputImage, cv::Mat &ocrImage, const cv::RotatedRect &blobBox, \
+                   const std::vector<int> &yCoords, const cv::Mat &mask, TableGrid &grid, bool showStep = false);
   void RectAroundBiggestBlob(const cv::Mat &biggestBlob, cv::RotatedRect &rotRect, bool showStep = false);
 
-  void WriteResult(cv::Mat &srcImage, cv::Mat &inputImage, const std::vector<std::vector<cv::Rect>> &groupedRect);
+  // Lines of band on page and on source for OCR, also on ocrImage when it is a bigger one
+  void DrawBand(cv::Mat &srcImage, cv::Mat &inputImage, cv::Mat &ocrImage, const GridBand &band);
+
+  // Cells of grid on inputImage are recognized from the same area of ocrImage, which may be bigger
+  void WriteResult(const cv::Mat &ocrImage, cv::Mat &inputImage, const TableGrid &grid);
+  // Text of cell as recognized, before normalization
+  std::string RecognizeCell(const cv::Mat &cellImage, OCR &ocr, int &confidence, bool upscale = true, CellType type = TextCell);
+  // Normalizer of the job, default one if it has none
+  const TextNormalizer & Normalizer() const;
+  // Type of column from its recognized sample cells, text unless all of them agree
+  static CellType ColumnType(const std::vector<std::string> &samples);
   void ShowResult(){} // TODO
 
   /*Helper functions*/
   cv::Mat SetKernel(int morphShape, int w, int h);
-  cv::Mat ErodeImage(const cv::Mat &inputImage, int morphShape, int kerW, int kerH, bool showStep = false);
-  cv::Mat DilateImage(const cv::Mat &inputImage, int morphShape, int kerW, int kerH, bool showStep = false);
-  int CountWhite(const cv::Mat &inputImage);
-
-  std::vector<std::vector<cv::Rect>> GroupCells(const std::vector<cv::Rect> &rects, bool showStep = false);
-
-  void SortCells(std::vector<cv::Rect> &cells, bool showStep = false);
-
-  void FindBiggestBlob(cv::Mat inputImage, cv::Mat &biggestBlob, int morphShape, int kerW, int kerH, bool showStep = false);
-
-  void CleanStamp(cv::Mat &inputImage, bool showStep = false);
-
-  void DeskewImage(cv::Mat &inputImage, const cv::Mat &mask, bool showStep = false);
+  void ErodeImage(const cv::Mat &inputImage, cv::Mat &outputImage, int morphShape, int kerW, int kerH, bool showStep = false);
+  void DilateImage(const cv::Mat &inputImage, cv::Mat &outputImage, int morphShape, int kerW, int kerH, bool showStep = false);
+  // Summed-area table of non-white pixels of the page
+  void BuildInkMap(const cv::Mat &inputImage);
+  // Share of non-white pixels in cell of the page, from the table in O(1)
+  double InkRatio(const cv::Rect &cell);
+
+  void FindBiggestBlob(const cv::Mat &inputImage, cv::Mat &biggestBlob, BlobBuffers &buffers, int morphShape, int kerW, int kerH, bool showStep = false);
+  // Former search by flood fill from every pixel, kept as reference for the benchmark
+  void FindBiggestBlobFlood(cv::Mat inputImage, cv::Mat &biggestBlob, int morphShape, int kerW, int kerH);
+
+  // Stamp is searched on colorImage, which is inputImage itself or its downscaled color copy
+  void CleanStamp(cv::Mat &inputImage, const cv::Mat &colorImage, bool showStep = false);
+
+  // Mean angle of long lines of mask, in degrees
+  double SkewAngle(const cv::Mat &mask, bool showStep = false);
+  // Rotation by angle moves some pixel of image of given size by more than skewTolerance
+  bool SkewVisible(double angle, const cv::Size &size);
+  void DeskewImage(cv::Mat &inputImage, double angle, bool showStep = false);
 
   void ContrastInc(const cv::Mat &inputImage, cv::Mat &outputImage, bool showStep = false);
 
@@ -9,13 +9,6 @@
 
 namespace settings
 {
-  // Path until PDF file
-  extern std::string inPath;
-  // Path until destination folder
-  extern std::string outPath;
-  // Language recognition
-  extern const char * lang;
-
   /*Variables for contrast */
   const double alpha = 1.2; //[1-3]
   const int beta = -20; //[1-100]
@@ -38,6 +31,13 @@ namespace settings
   const int GausW = 3;
   const int GausH = 3;
 
+  /*Rows of page preprocessed at once, strip of 2560 px color rows stays in L2 cache*/
+  const int stripRows = 32;
+
+  /*Cells with smaller share of non-white pixels are blank and not recognized,
+   0.01 skips the same cells as the former whole percent test*/
+  const double minInkRatio = 0.01;
+
   /*Minimum non - zero pixels on ROI*/
   const int nonZero = 50;
 
@@ -54,14 +54,61 @@ namespace settings
   const int sizeHor = 4;
   const int sizeVer = 4;
 
+  /*Maximum shift of page corners in pixels, for which deskew is skipped*/
+  const double skewTolerance = 0.5;
+
   /*Minimum area for detecting stamp*/
   const int minStampArea = 35000;
 
-  /*Gap between cells*/
-  const int cellGap = 5;
+  /*Process pages in gray, stamp is searched on color thumbnail downscaled by stampThumbScale*/
+  const bool grayMode = false;
+  const int stampThumbScale = 4;
 
   /*DPI for extracted images from PDF*/
   const int dpi = 300;
+  /*Render pages straight at width x height instead of dpi and decode big JPEG scans reduced,
+   dpi is left for files without readable page sizes*/
+  const bool renderWorkingSize = true;
+
+  /*Times the page for OCR is bigger than the one for grid detection, 1 - the same page*/
+  const int ocrScale = 1;
+
+  /*Decode embedded scan images instead of rendering pages*/
+  const bool extractImages = true;
+
+  /*Layout templates: kept templates, line tolerance in pixels, step between samples,
+   share of line samples that must be inked, for all lines of a direction and for any single
+   one, and of samples beside lines that may be; an untemplated row inked like a line is a miss*/
+  const int layoutCacheSize = 32;
+  const int layoutTolerance = 3;
+  const int layoutSampleStep = 16;
+  const double layoutMatchRatio = 0.9;
+  const double layoutLineRatio = 0.75;
+  const double layoutBesideRatio = 0.5;
+
+  /*Column types are inferred from rows after the header up to typeSampleRows, from at least
+   typeMinSamples cells; characters recognized in number and date columns*/
+  const int typeSampleRows = 4;
+  const int typeMinSamples = 2;
+  const char numberChars[] = "0123456789.,-%";
+  const char dateChars[] = "0123456789./-";
+
+  /*Cache texts of cells by hash of their bitmap, at most ocrCacheSize texts; texts not used
+   for ocrCacheSize / 2 new ones are evicted*/
+  const bool ocrCache = true;
+  const int ocrCacheSize = 1000000;
+
+  /*CSV output: field delimiter, line ending, pages waiting for the writer thread*/
+  const char csvDelimiter[] = ",";
+  const char csvLineEnd[] = "\n";
+  const int csvQueueDepth = 16;
+
+  /*Number of pages processed in parallel*/
+  const int jobs = 1;
+
+  /*Number of cells of one page recognized in parallel*/
+  const int cellJobs = 1;
+
+  /*Number of rendered pages waiting for segmentation*/
+  const int queueDepth = 2;
 }
-
-enum{SET_VERTICAL, SET_HORIZONTAL};
@@ -0,0 +1,35 @@
+#include "tablegrid.h"
+
+void TableGrid::Clear()
+{
+  m_cells.clear();
+  m_bands.clear();
+  m_rows = 0;
+}
+
+void TableGrid::AddRow(int top, int bottom, const std::vector<int> &xs, int horThickness, int verThickness)
+{
+  m_bands.push_back({top, bottom, xs});
+
+  // First pixel on each side not covered by a line of given thickness
+  const int horHalf = horThickness / 2 + 1;
+  const int verHalf = verThickness / 2 + 1;
+
+  const int y = top + horHalf;
+  const int height = bottom - top - 2 * horHalf + 1;
+
+  int col = 0;
+  for(size_t i = 0; i + 1 < xs.size(); ++i)
+  {
+    const cv::Rect rect(xs[i] + verHalf, y, xs[i + 1] - xs[i] - 2 * verHalf + 1, height);
+
+    // Slivers between lines that nearly coincide are not cells
+    if(rect.width <= 4 || rect.height <= 1)
+      continue;
+
+    m_cells.push_back({m_rows, col++, rect});
+  }
+
+  if(col > 0)
+    ++m_rows;
+}
@@ -0,0 +1,51 @@
+#ifndef TABLEGRID_H
+#define TABLEGRID_H
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <vector>
+
+// Cell of table: position in CSV and its area on the page, inside the border lines
+struct GridCell
+{
+  int row;
+  int col;
+  cv::Rect rect;
+};
+
+// Row band between two horizontal lines and its vertical lines, as drawn on the page
+struct GridBand
+{
+  int top;
+  int bottom;
+  std::vector<int> xs; // with left and right borders
+};
+
+/* Table built directly from detected line coordinates.
+ * Every row band between two horizontal lines is split by its own vertical
+ * lines, so rows may have different numbers of columns. Cells are stored
+ * flat in row-major order; bands without cells do not make a row.
+ */
+class TableGrid
+{
+public:
+  void Clear();
+
+  // Band between horizontal lines top and bottom, split at increasing xs which
+  // include the left and right borders. Thickness is that of the drawn lines.
+  void AddRow(int top, int bottom, const std::vector<int> &xs, int horThickness, int verThickness);
+
+  const std::vector<GridCell> & Cells() const { return m_cells; }
+
+  // Geometry the grid was built from, enough to rebuild it
+  const std::vector<GridBand> & Bands() const { return m_bands; }
+
+  int Rows() const { return m_rows; }
+
+private:
+  std::vector<GridCell> m_cells;
+  std::vector<GridBand> m_bands;
+  int m_rows = 0;
+};
+
+#endif // TABLEGRID_H
@@ -0,0 +1,124 @@
+#include "textnormalizer.h"
+#include "settings.h"
+
+#include <algorithm>
+
+TextNormalizer::TextNormalizer()
+{
+  for(Rule &rule : m_rules)
+  {
+    for(char32_t c = '0'; c <= '9'; ++c)
+      rule.narrow.set(c);
+    for(char32_t c = 0x0410; c <= 0x044F; ++c)
+      rule.narrow.set(c);
+  }
+
+  // Separators of numbers and dates are not noise in their columns
+  Keep(NumberCell, settings::numberChars);
+  Keep(DateCell, settings::dateChars);
+}
+
+void TextNormalizer::Keep(CellType type, const std::string &chars)
+{
+  Rule &rule = m_rules[type];
+  const unsigned char * p = reinterpret_cast<const unsigned char *>(chars.data());
+  const unsigned char * end = p + chars.size();
+  while(p < end)
+  {
+    int length = 1;
+    const char32_t c = Decode(p, end, length);
+    if(c < 0x800)
+      rule.narrow.set(c);
+    else if(c != invalidChar)
+      rule.wide.push_back(c);
+    p += length;
+  }
+
+  std::sort(rule.wide.begin(), rule.wide.end());
+  rule.wide.erase(std::unique(rule.wide.begin(), rule.wide.end()), rule.wide.end());
+}
+
+std::string TextNormalizer::Normalize(const std::string &text, CellType type) const
+{
+  const Rule &rule = m_rules[type];
+  std::string result;
+  result.reserve(text.size());
+
+  const unsigned char * p = reinterpret_cast<const unsigned char *>(text.data());
+  const unsigned char * end = p + text.size();
+  bool gap = false; // characters dropped after the last kept one
+
+  while(p < end)
+  {
+    // ASCII is tested byte by byte without decoding
+    int length = 1;
+    const char32_t c = *p < 0x80 ? *p : Decode(p, end, length);
+    const bool keep = c < 0x800 ? rule.narrow[c] : std::binary_search(rule.wide.begin(), rule.wide.end(), c);
+
+    if(keep)
+    {
+      // Gap before the first kept character is trimmed, the one after the last is never written
+      if(gap && !result.empty())
+        result.push_back(' ');
+      result.append(reinterpret_cast<const char *>(p), length);
+      gap = false;
+    }
+    else
+      gap = true;
+
+    p += length;
+  }
+
+  return result;
+}
+
+char32_t TextNormalizer::Decode(const unsigned char *text, const unsigned char *end, int &length)
+{
+  const unsigned char lead = text[0];
+  int count = 0;
+  char32_t c = 0;
+  if(lead < 0x80)
+  {
+    length = 1;
+    return lead;
+  }
+  else if(lead >= 0xC2 && lead <= 0xDF)
+  {
+    count = 1;
+    c = lead & 0x1F;
+  }
+  else if(lead >= 0xE0 && lead <= 0xEF)
+  {
+    count = 2;
+    c = lead & 0x0F;
+  }
+  else if(lead >= 0xF0 && lead <= 0xF4)
+  {
+    count = 3;
+    c = lead & 0x07;
+  }
+  else
+  {
+    length = 1;
+    return invalidChar;
+  }
+
+  if(end - text <= count)
+  {
+    length = 1;
+    return invalidChar;
+  }
+
+  for(int i = 1; i <= count; ++i)
+  {
+    if((text[i] & 0xC0) != 0x80)
+    {
+      length = 1;
+      return invalidChar;
+    }
+    c = (c << 6) | (text[i] & 0x3F);
+  }
+
+  length = count + 1;
+  return c;
+}
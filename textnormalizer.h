@@ -0,0 +1,43 @@
+#ifndef TEXTNORMALIZER_H
+#define TEXTNORMALIZER_H
+
+#include "ocr.h"
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+/* Post-processing of recognized text, straight on UTF-8 bytes.
+ * A rule is the set of kept characters: ASCII and two-byte sequences
+ * (Latin, Cyrillic) are looked up in a bit table by code point, longer
+ * ones in a sorted list. Runs of other characters and whitespace become
+ * one space and the ends are trimmed. Rules are built once per job, every
+ * column type has its own; Normalize is const and may run in any thread.
+ */
+class TextNormalizer
+{
+public:
+  // Every type keeps ASCII digits and Cyrillic А-я (U+0410..U+044F), number and
+  // date cells also the characters recognized in them, settings::numberChars and dateChars
+  TextNormalizer();
+
+  // Keep also characters of chars, given in UTF-8, in cells of type
+  void Keep(CellType type, const std::string &chars);
+
+  std::string Normalize(const std::string &text, CellType type = TextCell) const;
+
+private:
+  struct Rule
+  {
+    std::bitset<0x800> narrow; // code points below U+0800, one or two bytes
+    std::vector<char32_t> wide; // sorted
+  };
+
+  Rule m_rules[DateCell + 1];
+
+  // Code point of sequence at text and its length, a broken sequence is invalidChar of one byte
+  static char32_t Decode(const unsigned char *text, const unsigned char *end, int &length);
+  static const char32_t invalidChar = 0x110000; // outside Unicode, never kept
+};
+
+#endif // TEXTNORMALIZER_H
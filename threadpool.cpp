@@ -0,0 +1,147 @@
+#include "threadpool.h"
+
+#include <iostream>
+
+ThreadPool::ThreadPool(int threadCount)
+{
+  if(threadCount < 1)
+    threadCount = 1;
+
+  for(int i = 0; i < threadCount; ++i)
+    m_queues.emplace_back(new WorkQueue);
+
+  for(int i = 0; i < threadCount; ++i)
+    m_threads.emplace_back(&ThreadPool::Run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(m_stateLock);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  for(auto &t:m_threads)
+    t.join();
+}
+
+void ThreadPool::Submit(Task task)
+{
+  const int idx = m_next++ % m_queues.size();
+  {
+    std::lock_guard<std::mutex> guard(m_queues[idx]->lock);
+    m_queues[idx]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_stateLock);
+    ++m_queued;
+    ++m_pending;
+  }
+  m_wake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+  std::unique_lock<std::mutex> guard(m_stateLock);
+  m_done.wait(guard, [this]{ return m_pending == 0; });
+}
+
+bool ThreadPool::PopLocal(int idx, Task &task)
+{
+  std::lock_guard<std::mutex> guard(m_queues[idx]->lock);
+  if(m_queues[idx]->tasks.empty())
+    return false;
+
+  task = std::move(m_queues[idx]->tasks.back());
+  m_queues[idx]->tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::Steal(int idx, Task &task)
+{
+  const int count = m_queues.size();
+  for(int i = 1; i < count; ++i)
+  {
+    WorkQueue &victim = *m_queues[(idx + i) % count];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if(!victim.tasks.empty())
+    {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Run(int idx)
+{
+  for(;;)
+  {
+    {
+      std::unique_lock<std::mutex> guard(m_stateLock);
+      m_wake.wait(guard, [this]{ return m_queued > 0 || m_stop; });
+      if(m_queued == 0 && m_stop)
+        return;
+      --m_queued; // reserve one of the queued tasks
+    }
+
+    // The reservation guarantees a task is left in some queue
+    Task task;
+    while(!PopLocal(idx, task) && !Steal(idx, task))
+      std::this_thread::yield();
+
+    try
+    {
+      task(idx);
+    }
+    catch(std::exception const &ex)
+    {
+      std::cerr << "Caught exception in worker " << idx << ": " << ex.what() << std::endl;
+    }
+
+    bool finished = false;
+    {
+      std::lock_guard<std::mutex> guard(m_stateLock);
+      finished = (--m_pending == 0);
+    }
+    if(finished)
+      m_done.notify_all();
+  }
+}
+
+void TaskGroup::Submit(ThreadPool::Task task)
+{
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    ++m_pending;
+  }
+
+  m_pool.Submit([this, task](int worker)
+  {
+    try
+    {
+      task(worker);
+    }
+    catch(...)
+    {
+      Finish();
+      throw;
+    }
+    Finish();
+  });
+}
+
+void TaskGroup::Wait()
+{
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_done.wait(guard, [this]{ return m_pending == 0; });
+}
+
+void TaskGroup::Finish()
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  if(--m_pending == 0)
+    m_done.notify_all();
+}
@@ -0,0 +1,86 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Work-stealing thread pool.
+ * Every worker owns a task deque: it pops its own tasks from the back and,
+ * when it runs dry, steals from the front of the other workers' deques.
+ * Tasks receive the index of the worker that runs them, so callers can keep
+ * per-worker state (OCR engine, scratch buffers) in a plain array.
+ */
+class ThreadPool
+{
+public:
+  typedef std::function<void(int)> Task;
+
+  explicit ThreadPool(int threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  // Queue task for execution
+  void Submit(Task task);
+
+  // Block until every submitted task is finished
+  void Wait();
+
+  int Size() const { return static_cast<int>(m_threads.size()); }
+
+private:
+  struct WorkQueue
+  {
+    std::deque<Task> tasks;
+    std::mutex lock;
+  };
+
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_stateLock;
+  std::condition_variable m_wake; // new task or stop request
+  std::condition_variable m_done; // all tasks finished
+
+  int m_queued = 0;  // queued tasks not yet reserved by a worker
+  int m_pending = 0; // tasks queued or running
+  bool m_stop = false;
+
+  std::atomic<unsigned> m_next{0}; // round-robin submit position
+
+  bool PopLocal(int idx, Task &task);
+  bool Steal(int idx, Task &task);
+  void Run(int idx);
+};
+
+/* Batch of tasks on a shared pool that can be waited for independently
+ * of the other tasks running on the same pool.
+ */
+class TaskGroup
+{
+public:
+  explicit TaskGroup(ThreadPool &pool): m_pool(pool) {}
+  ~TaskGroup() { Wait(); }
+
+  void Submit(ThreadPool::Task task);
+
+  // Block until every task of this group is finished
+  void Wait();
+
+private:
+  ThreadPool &m_pool;
+  std::mutex m_lock;
+  std::condition_variable m_done;
+  int m_pending = 0;
+
+  void Finish();
+};
+
+#endif // THREADPOOL_H